@@ -0,0 +1,350 @@
+#include "UMSHeap.h"
+
+
+static inline unsigned long ums_heap_hash(ums_heap* h, ums_t id){
+    return ((unsigned long) id * 0x9E3779B97F4A7C15UL >> 16) & h->map_mask;
+}
+
+/**
+ * @p h the heap \n 
+ * @p id the ID of a thread \n 
+ * 
+ * Returns the slot of the map in which @p id is saved, or the free slot in which it would be saved.
+ */
+static unsigned long ums_heap_map_slot(ums_heap* h, ums_t id){
+    unsigned long i = ums_heap_hash(h, id);
+
+    while(h->map[i] && h->map_ids[i] != id)
+        i = (i + 1) & h->map_mask;
+
+    return i;
+}
+
+static inline void ums_heap_map_set(ums_heap* h, ums_t id, int pos){
+    unsigned long i = ums_heap_map_slot(h, id);
+
+    h->map_ids[i] = id;
+    h->map[i] = pos + 1;
+}
+
+/**
+ * @p h the heap \n 
+ * @p id the ID of a thread \n 
+ * 
+ * Removes @p id from the map; the following entries are shifted back, so that no tombstone is needed.
+ */
+static void ums_heap_map_del(ums_heap* h, ums_t id){
+    unsigned long i = ums_heap_map_slot(h, id), j = i, k;
+
+    if(!h->map[i])
+        return;
+    h->map[i] = 0;
+
+    while(1){
+        j = (j + 1) & h->map_mask;
+        if(!h->map[j])
+            break;
+        k = ums_heap_hash(h, h->map_ids[j]);
+        //move the entry in the hole only if its home slot is not between the hole and the entry itself
+        if((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        h->map[i] = h->map[j];
+        h->map_ids[i] = h->map_ids[j];
+        h->map[j] = 0;
+        i = j;
+    }
+}
+
+/**
+ * @p h the heap \n 
+ * @p capacity the new capacity \n 
+ * 
+ * Resizes the heap and rebuilds the map. Returns -1 if the memory could not be allocated, and then the heap is left
+ * as it was.
+ */
+static int ums_heap_resize(ums_heap* h, int capacity){
+    ums_heap_item* items;
+    int* map;
+    ums_t* map_ids;
+    unsigned long map_size = 1;
+    int i;
+
+    while(map_size < 2 * (unsigned long) capacity)
+        map_size <<= 1;
+
+    //the new map is allocated before the items are touched, so that nothing changes if any allocation fails
+    map = (int*) calloc(map_size, sizeof(int));
+    map_ids = (ums_t*) malloc(map_size * sizeof(ums_t));
+    if(!map || !map_ids){
+        free(map);
+        free(map_ids);
+        return -1;
+    }
+
+    items = (ums_heap_item*) realloc(h->items, capacity * sizeof(ums_heap_item));
+    if(!items){
+        free(map);
+        free(map_ids);
+        return -1;
+    }
+    h->items = items;
+    h->capacity = capacity;
+
+    free(h->map);
+    free(h->map_ids);
+    h->map = map;
+    h->map_ids = map_ids;
+    h->map_mask = map_size - 1;
+
+    for(i = 0; i < h->len; i++)
+        ums_heap_map_set(h, h->items[i].ums_id, i);
+
+    return 0;
+}
+
+static inline int ums_heap_less(ums_heap_item* a, ums_heap_item* b){
+    return a->prio < b->prio || (a->prio == b->prio && a->seq < b->seq);
+}
+
+static void ums_heap_sift_up(ums_heap* h, int pos){
+    ums_heap_item item = h->items[pos];
+    int parent;
+
+    while(pos > 0){
+        parent = (pos - 1) / 2;
+        if(!ums_heap_less(&item, &h->items[parent]))
+            break;
+        h->items[pos] = h->items[parent];
+        ums_heap_map_set(h, h->items[pos].ums_id, pos);
+        pos = parent;
+    }
+    h->items[pos] = item;
+    ums_heap_map_set(h, item.ums_id, pos);
+}
+
+static void ums_heap_sift_down(ums_heap* h, int pos){
+    ums_heap_item item = h->items[pos];
+    int child;
+
+    while((child = 2 * pos + 1) < h->len){
+        if(child + 1 < h->len && ums_heap_less(&h->items[child + 1], &h->items[child]))
+            child++;
+        if(!ums_heap_less(&h->items[child], &item))
+            break;
+        h->items[pos] = h->items[child];
+        ums_heap_map_set(h, h->items[pos].ums_id, pos);
+        pos = child;
+    }
+    h->items[pos] = item;
+    ums_heap_map_set(h, item.ums_id, pos);
+}
+
+/**
+ * @fn ums_heap_create
+ * 
+ * Creates an empty heap, that has to be deleted with ums_heap_delete(). NULL is returned if the memory could not be
+ * allocated.
+ */
+ums_heap* ums_heap_create(){
+    ums_heap* h = (ums_heap*) calloc(1, sizeof(ums_heap));
+
+    if(!h)
+        return NULL;
+
+    if(ums_heap_resize(h, UMS_HEAP_MIN_CAPACITY)){
+        ums_heap_delete(h);
+        return NULL;
+    }
+
+    return h;
+}
+
+/**
+ * @p h the heap to be deleted
+ * 
+ * Deletes the heap and frees its memory.
+ */
+void ums_heap_delete(ums_heap* h){
+
+    free(h->items);
+    free(h->map);
+    free(h->map_ids);
+    free(h);
+}
+
+/**
+ * @p h the heap
+ * 
+ * Removes all the threads from the heap; the memory is kept, so that the heap can be filled again without allocating.
+ */
+void ums_heap_clear(ums_heap* h){
+
+    memset(h->map, 0, (h->map_mask + 1) * sizeof(int));
+    h->len = 0;
+    h->seq = 0;
+}
+
+/**
+ * @p h the heap
+ * 
+ * Returns the number of threads in the heap.
+ */
+int ums_heap_len(ums_heap* h){
+    return h->len;
+}
+
+/**
+ * @p h the heap \n 
+ * @p ums_id the id of the thread \n 
+ * @p prio the priority of the thread \n 
+ * 
+ * Adds a thread to the heap, in O(log n). If the thread is already in the heap, its priority is updated. Either
+ * way the thread belongs to the current round (see ums_heap_prune()). Returns -1 if the memory could not be
+ * allocated.
+ */
+int ums_heap_push(ums_heap* h, ums_t ums_id, int prio){
+
+    if(h->map[ums_heap_map_slot(h, ums_id)])
+        return ums_heap_update(h, ums_id, prio);
+
+    if(h->len == h->capacity && ums_heap_resize(h, 2 * h->capacity))
+        return -1;
+
+    h->items[h->len].ums_id = ums_id;
+    h->items[h->len].prio = prio;
+    h->items[h->len].seq = h->seq++;
+    h->items[h->len].round = h->round;
+    h->len++;
+    ums_heap_sift_up(h, h->len - 1);
+
+    return 0;
+}
+
+/**
+ * @p h the heap
+ * 
+ * Returns the thread with the highest priority (the lowest prio), without removing it, in O(1); 0 if the heap is empty.
+ */
+ums_t ums_heap_top(ums_heap* h){
+    return h->len ? h->items[0].ums_id : 0;
+}
+
+/**
+ * @p h the heap
+ * 
+ * Removes and returns the thread with the highest priority (the lowest prio); 0 if the heap is empty. The thread is
+ * found in O(1), restoring the heap takes O(log n).
+ */
+ums_t ums_heap_pop(ums_heap* h){
+    ums_t id;
+
+    if(!h->len)
+        return 0;
+
+    id = h->items[0].ums_id;
+    ums_heap_map_del(h, id);
+
+    h->len--;
+    if(h->len){
+        h->items[0] = h->items[h->len];
+        ums_heap_sift_down(h, 0);
+    }
+
+    return id;
+}
+
+/**
+ * @p h the heap \n 
+ * @p ums_id the id of the thread \n 
+ * @p prio the new priority of the thread \n 
+ * 
+ * Changes the priority of a thread that is in the heap (decrease-key, but a higher prio is accepted as well), in
+ * O(log n); nothing moves if the priority is the same. Returns -1 if the thread is not in the heap.
+ */
+int ums_heap_update(ums_heap* h, ums_t ums_id, int prio){
+    unsigned long slot = ums_heap_map_slot(h, ums_id);
+    int pos, old;
+
+    if(!h->map[slot])
+        return -1;
+
+    pos = h->map[slot] - 1;
+    old = h->items[pos].prio;
+    h->items[pos].prio = prio;
+    h->items[pos].round = h->round;
+
+    if(prio < old)
+        ums_heap_sift_up(h, pos);
+    else if(prio > old)
+        ums_heap_sift_down(h, pos);
+
+    return 0;
+}
+
+/**
+ * @p h the heap \n 
+ * @p ums_id the id of the thread \n 
+ * 
+ * Removes a thread from the heap, in O(log n). Returns -1 if the thread is not in the heap.
+ */
+int ums_heap_remove(ums_heap* h, ums_t ums_id){
+    unsigned long slot = ums_heap_map_slot(h, ums_id);
+    ums_heap_item* last;
+    int pos;
+
+    if(!h->map[slot])
+        return -1;
+
+    pos = h->map[slot] - 1;
+    ums_heap_map_del(h, ums_id);
+
+    h->len--;
+    if(pos == h->len)
+        return 0;
+
+    last = &h->items[h->len];
+    if(ums_heap_less(last, &h->items[pos])){
+        h->items[pos] = *last;
+        ums_heap_sift_up(h, pos);
+    }
+    else{
+        h->items[pos] = *last;
+        ums_heap_sift_down(h, pos);
+    }
+
+    return 0;
+}
+
+/**
+ * @p h the heap
+ * 
+ * Starts a new round: the threads that are pushed (or updated) from now on belong to it, see ums_heap_prune().
+ */
+void ums_heap_new_round(ums_heap* h){
+    h->round++;
+}
+
+/**
+ * @p h the heap
+ * 
+ * Removes the threads that were not pushed (nor updated) in the current round, in O(n): the remaining ones are
+ * compacted and the heap is built again. Meant for the threads that disappeared all at once (e.g. removed from a
+ * completion list), a single thread is better removed with ums_heap_remove().
+ */
+void ums_heap_prune(ums_heap* h){
+    int i, len = 0;
+
+    for(i = 0; i < h->len; i++){
+        if(h->items[i].round == h->round)
+            h->items[len++] = h->items[i];
+    }
+    if(len == h->len)
+        return;
+    h->len = len;
+
+    memset(h->map, 0, (h->map_mask + 1) * sizeof(int));
+    for(i = 0; i < len; i++)
+        ums_heap_map_set(h, h->items[i].ums_id, i);
+    for(i = len / 2 - 1; i >= 0; i--)
+        ums_heap_sift_down(h, i);
+}
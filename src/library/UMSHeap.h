@@ -0,0 +1,63 @@
+/**
+ * @file UMSHeap.h
+ * @brief Priority queues of ready threads.
+ * 
+ * A ums_heap contains the ready threads of a scheduler ordered by priority (the lowest prio first, as in the
+ * completion lists; threads with the same prio are returned in the order in which they were added). It is meant to be
+ * owned by a single scheduler, thus it is not protected by any lock.
+ */
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef pthread_t ums_t;
+
+#define UMS_HEAP_MIN_CAPACITY       16
+
+/**
+ * @p ums_id ID of the thread \n 
+ * @p prio the priority given by the user \n 
+ * @p seq insertion order, used to break the ties \n 
+ * @p round the round of the heap in which the thread was last pushed (see ums_heap_prune()) \n 
+ */
+typedef struct ums_heap_item{
+    ums_t ums_id;
+    int prio;
+    unsigned long seq;
+    unsigned long round;
+}ums_heap_item;
+
+/**
+ * @p items the binary heap \n 
+ * @p len number of threads in the heap \n 
+ * @p capacity number of slots of @p items \n 
+ * @p seq next insertion number \n 
+ * @p map open addressing table from the ID of a thread to its position in @p items (+1, 0 is a free slot) \n 
+ * @p map_ids the IDs of the slots of @p map \n 
+ * @p map_mask number of slots of @p map - 1, it is a power of 2 at least twice @p capacity \n 
+ * @p round current round, see ums_heap_new_round() \n 
+ */
+typedef struct ums_heap{
+    ums_heap_item* items;
+    int len;
+    int capacity;
+    unsigned long seq;
+    int* map;
+    ums_t* map_ids;
+    unsigned long map_mask;
+    unsigned long round;
+}ums_heap;
+
+
+ums_heap* ums_heap_create(void);
+void ums_heap_delete(ums_heap*);
+void ums_heap_clear(ums_heap*);
+int ums_heap_len(ums_heap*);
+int ums_heap_push(ums_heap*, ums_t, int);
+ums_t ums_heap_top(ums_heap*);
+ums_t ums_heap_pop(ums_heap*);
+int ums_heap_update(ums_heap*, ums_t, int);
+int ums_heap_remove(ums_heap*, ums_t);
+void ums_heap_new_round(ums_heap*);
+void ums_heap_prune(ums_heap*);
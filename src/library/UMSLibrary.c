@@ -1,4 +1,5 @@
 #include "UMSLibrary.h"
+#include <string.h>
 
 //If this is not added, doxygen parse the next two lines in a "strange" way
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -7,16 +8,34 @@ __attribute__((section(".fini_array"))) typeof(UMS_exit) *__fini = UMS_exit;
 #endif /* DOXYGEN_SHOULD_SKIP_THIS */
 
 
-//descriptor of the device file
-int fd;
+//descriptor of the device file, -1 if the kernel module is not used
+int fd = -1;
 
-/*variables and semaphores used to start the schedulers;
-the schedulers wait for all the threads to be initialized before starting
-this is done to avoid problems like a scheduler starting with 0 thread,
-that will lead to an early finish of the scheduler
+//UMS_BACKEND_KERNEL, UMS_BACKEND_COROUTINE or UMS_BACKEND_FUTEX, see UMSUserBackend.h
+int ums_backend = UMS_DEFAULT_BACKEND;
+
+//ready ring of the calling scheduler, mapped from the device file; NULL in workers (or if the mapping failed)
+__thread ums_ready_ring* ready_ring;
+
+/*pool of worker threads (kernel backend, see ums_set_worker_pool()): pool_parked is the stack of the threads parked
+in the kernel module, waiting for a new worker to run; at most pool_max of them are kept
 */
-int worker_num, loaded_num;
-sem_t num_sem;
+working_wrapper_routine_arg* pool_parked;
+int pool_parked_num;
+int pool_max;
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//the worker run by the calling thread, if it is a pooled one
+__thread ums_worker* pool_task;
+
+//the CPUs of the process when it started, given back to the pooled threads that are reused without a CPU
+cpu_set_t ums_all_cpus;
+
+/*threads of the workers that are not in the registry (kernel backend, no pool) and did not end yet, by pthread ID;
+only these ones are pinned by ums_pin_worker(), since the pthread ID of a thread that is over is not valid anymore
+*/
+working_wrapper_routine_arg* live_workers[UMS_LIVE_BUCKETS];
+pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
 
 
 /**
@@ -24,13 +43,31 @@ sem_t num_sem;
  * Initialize the connection with the kernel module; the kernel module need
  * to be already loaded when starting your application. This function is inserted in the section
  * init_array, thus it will be called before the main function; be carefull while modifying that section.
+ * The backend can be chosen with the environment variable UMS_BACKEND (kernel, coroutine or futex); with the coroutine
+ * backend the kernel module is not used at all, with the futex backend it is only used (if loaded) for the /proc fs.
  * 
  */
 
 void UMS_init(){
-    int ret;
+    char* backend = getenv("UMS_BACKEND");
+
+    if(backend && !strcmp(backend, "coroutine"))
+        ums_backend = UMS_BACKEND_COROUTINE;
+    else if(backend && !strcmp(backend, "futex"))
+        ums_backend = UMS_BACKEND_FUTEX;
+    else if(backend && !strcmp(backend, "kernel"))
+        ums_backend = UMS_BACKEND_KERNEL;
+
+    sched_getaffinity(0, sizeof(ums_all_cpus), &ums_all_cpus);
+
+    if(ums_backend == UMS_BACKEND_COROUTINE)
+        return;
 
     if( access( DEVICE_PATH, F_OK ) != 0 ) {
+        if(ums_backend == UMS_BACKEND_FUTEX){
+            printf("Device file not found, the /proc fs will not be available.\n");
+            return;
+        }
         printf("Device file not found! Is the kernel module loaded?\n");
         exit(UMS_ERROR_INIT);
     }
@@ -43,12 +80,6 @@ void UMS_init(){
 
     DO_IOCTL(fd, INIT_UMS_PROCESS, 0);
 
-    ret = sem_init(&num_sem, 0, 1);
-    if(ret == -1){
-        printf("Could not initialize the semaphore Aborting");
-        exit(UMS_ERROR_SEM);
-    }
-
 }
 
 /**
@@ -60,11 +91,8 @@ void UMS_init(){
 void UMS_exit(){
     int ret;
 
-    ret = sem_destroy(&num_sem);
-    if(ret == -1){
-        printf("Could not remove the semaphore, Aborting");
-        exit(UMS_ERROR_SEM);
-    }
+    if(fd == -1)
+        return;
     
     DO_IOCTL(fd, EXIT_UMS_PROCESS, 0);
 
@@ -88,7 +116,39 @@ void UMS_exit(){
  * 
  */
 ums_t EnterUmsSchedulingMode(void* list, void *(*start_routine) (completion_list *, void *), void* arg){
+    return ums_create_scheduler(list, start_routine, arg, -1);
+}
+
+/**
+ *
+ * @p list the completion list of the scheduler \n 
+ * @p start_routine the function that will execute the scheduler \n 
+ * @p arg the argument of the scheduler's function \n 
+ * @p cpu the CPU on which the scheduler runs \n 
+ * 
+ * Same as EnterUmsSchedulingMode(), but the scheduler is pinned to @p cpu, and so are the threads of its completion
+ * list (the ones already in it and the ones added later), so that the switches stay on the same core and its caches
+ * stay warm. If the list is shared by schedulers pinned to different CPUs, its threads can run on any of them. The
+ * scheduler starts on @p cpu, thus its stack and its data in the kernel module are allocated on the NUMA node of
+ * @p cpu.
+ */
+ums_t EnterUmsSchedulingModeOnCpu(void* list, void *(*start_routine) (completion_list *, void *), void* arg, int cpu){
+    return ums_create_scheduler(list, start_routine, arg, cpu);
+}
+
+/**
+ * @p list the completion list of the scheduler \n 
+ * @p start_routine the function that will execute the scheduler \n 
+ * @p arg the argument of the scheduler's function \n 
+ * @p cpu the CPU on which the scheduler runs, -1 if it can run anywhere \n 
+ * 
+ * Core of EnterUmsSchedulingMode() and EnterUmsSchedulingModeOnCpu().
+ */
+ums_t ums_create_scheduler(void* list, void *(*start_routine) (completion_list *, void *), void* arg, int cpu){
     ums_t id;
+    pthread_attr_t attr;
+    completion_list* cs = (completion_list*) list;
+    completion_list_item* item;
 
     //printf("Creating scheduler thread.\n");
 
@@ -96,50 +156,158 @@ ums_t EnterUmsSchedulingMode(void* list, void *(*start_routine) (completion_list
     wrapper_arg->start_routine = start_routine;
     wrapper_arg->arg = arg;
     wrapper_arg->list=list;
-    
-    pthread_create(&id, NULL, SchedulerThreadWrapper, wrapper_arg);
+
+    if(cpu >= 0){
+        //the threads of the list follow its schedulers, see completion_list_append()
+        sem_wait(&cs->sem);
+        CPU_SET(cpu, &cs->cpus);
+        cs->pinned = 1;
+        for(item = cs->head; item; item = item->next)
+            ums_pin_worker(item->ums_id, &cs->cpus);
+        sem_post(&cs->sem);
+    }
+
+    ums_thread_attr(&attr, cpu);
+    //it fails if cpu is not a CPU of the process
+    if(pthread_create(&id, &attr, SchedulerThreadWrapper, wrapper_arg)){
+        printf("Could not create the scheduler! Aborting\n");
+        exit(UMS_ERROR_THREAD);
+    }
+    pthread_attr_destroy(&attr);
 
     return id;
 }
 
+/**
+ * @p attr the attributes to be initialized \n 
+ * @p cpu the CPU on which the new thread runs, -1 if it can run anywhere \n 
+ * 
+ * Initializes the attributes of a new thread. A pinned thread starts directly on its CPU, thus its stack is allocated
+ * on the NUMA node of that CPU (the pages go to the node of the thread that touches them first).
+ */
+void ums_thread_attr(pthread_attr_t* attr, int cpu){
+    cpu_set_t set;
+
+    pthread_attr_init(attr);
+    if(cpu < 0)
+        return;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
+
+/**
+ * @p ums_id the id of the worker \n 
+ * @p cpus the CPUs on which the worker can run \n 
+ * 
+ * Restricts the thread of a worker to @p cpus. Nothing is done with the coroutine backend, where the workers run on
+ * the thread of the scheduler that executes them. A worker that is over is not pinned, its thread may be gone (the
+ * lists keep the ids of the workers that ended). Returns 0 on success, an error number otherwise.
+ */
+int ums_pin_worker(ums_t ums_id, cpu_set_t* cpus){
+    working_wrapper_routine_arg* t;
+    int ret = ESRCH;
+
+    if(ums_backend == UMS_BACKEND_COROUTINE)
+        return 0;
+
+    //futex workers and pooled workers are in the registry, the others are plain threads
+    if(ums_id & UMS_REGISTRY_ID_TAG)
+        return ums_worker_pin(ums_id, cpus);
+
+    //the thread does not end while it is in the set, see WorkingThreadWrapper()
+    pthread_mutex_lock(&live_lock);
+    for(t = live_workers[UMS_LIVE_HASH(ums_id)]; t; t = t->next_live){
+        if(t->thread == (pthread_t) ums_id){
+            ret = pthread_setaffinity_np(t->thread, sizeof(cpu_set_t), cpus);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&live_lock);
+
+    return ret;
+}
+
+/**
+ * @p t the argument of the worker's thread
+ * 
+ * Adds the thread of a new worker (not pooled) to the set of the live ones, so that it can be pinned.
+ */
+void ums_live_add(working_wrapper_routine_arg* t){
+    unsigned long bucket = UMS_LIVE_HASH(t->thread);
+
+    pthread_mutex_lock(&live_lock);
+    t->next_live = live_workers[bucket];
+    live_workers[bucket] = t;
+    pthread_mutex_unlock(&live_lock);
+}
+
+/**
+ * @p t the argument of the worker's thread
+ * 
+ * Removes the thread of a worker from the set of the live ones, before it ends; from now on it is not pinned anymore.
+ */
+void ums_live_remove(working_wrapper_routine_arg* t){
+    working_wrapper_routine_arg** prev;
+
+    pthread_mutex_lock(&live_lock);
+    for(prev = &live_workers[UMS_LIVE_HASH(t->thread)]; *prev; prev = &(*prev)->next_live){
+        if(*prev == t){
+            *prev = t->next_live;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&live_lock);
+}
+
 
 
 /**
  * @p arg the argument passed from the user, for the scheduler function
  * 
  * Contacts the kernel module to communicate that a new scheduler has spawned (also communicating the completion list)
- * then wait for all the workers to start and then it calls the user-defined scheduler's function.
+ * then it calls the user-defined scheduler's function. There is no need to wait for the workers: they are announced
+ * to the kernel module by EnterUmsWorkingMode(), thus a dequeue waits for the ones that did not register yet.
  */
 
 void* SchedulerThreadWrapper(void* arg){
-    int ret;
 
     shceduling_wrapper_routine_arg* wrapper_arg = (shceduling_wrapper_routine_arg*) arg;
 
-    while (worker_num != loaded_num){}
-
-    completion_list *cs = wrapper_arg->list;
-    unsigned long memory[cs->len + 1];
-    memory[0] = cs->len;
-    int i;
-
-    completion_list_item* item = cs->head;
-    completion_list_item* aux;
+    //coroutines are ready as soon as they are created, and the kernel module is not involved
+    if(ums_backend == UMS_BACKEND_COROUTINE){
+        wrapper_arg->start_routine(wrapper_arg->list, wrapper_arg->arg);
+        free(arg);
+        pthread_exit(0);
+    }
 
-    sem_wait(&cs->sem);
+    if(ums_backend == UMS_BACKEND_FUTEX){
+        if(fd != -1)
+            ums_introduce_scheduler(wrapper_arg->list);
 
-    for(i = 1; i<=cs->len; i++){
+        wrapper_arg->start_routine(wrapper_arg->list, wrapper_arg->arg);
 
-        memory[i] = item->ums_id;
+        //the switches were done in user space, the kernel module is told only once
+        if(fd != -1)
+            DO_IOCTL(fd, UMS_ACCOUNT_SWITCHES, &ums_co_get_thread()->switches);
 
-        item = item->next;
+        free(arg);
+        pthread_exit(0);
     }
-    sem_post(&cs->sem);
 
-    DO_IOCTL(fd, INTRODUCE_UMS_SCHEDULER, &memory);
+    ums_introduce_scheduler(wrapper_arg->list);
+
+    //the ring is an optimization, without it the scheduler can still use DequeueUmsCompletionListItems()
+    ready_ring = (ums_ready_ring*) mmap(NULL, sizeof(ums_ready_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(ready_ring == MAP_FAILED)
+        ready_ring = NULL;
 
     wrapper_arg->start_routine(wrapper_arg->list, wrapper_arg->arg);
 
+    if(ready_ring)
+        munmap(ready_ring, sizeof(ums_ready_ring));
+
 
     free(arg);
     pthread_exit(0);
@@ -156,19 +324,127 @@ void* SchedulerThreadWrapper(void* arg){
  * 
  */
 ums_t EnterUmsWorkingMode(void *(*start_routine) (void *), void* arg){
+    return ums_create_worker(start_routine, arg, -1);
+}
+
+/**
+ *
+ * @p start_routine the function that will execute the worker\n
+ * @p arg the argument of the worker's function\n
+ * @p cpu the CPU on which the worker runs\n
+ * 
+ * Same as EnterUmsWorkingMode(), but the worker is pinned to @p cpu (usually the one of its scheduler). A worker added
+ * to the completion list of a pinned scheduler is pinned anyway, so this is only needed for the other lists.
+ * Coroutines run on the thread of their scheduler, thus @p cpu is ignored with that backend.
+ */
+ums_t EnterUmsWorkingModeOnCpu(void *(*start_routine) (void *), void* arg, int cpu){
+    return ums_create_worker(start_routine, arg, cpu);
+}
+
+/**
+ * @p start_routine the function that will execute the worker \n 
+ * @p arg the argument of the worker's function \n 
+ * @p cpu the CPU on which the worker runs, -1 if it can run anywhere \n 
+ * 
+ * Core of EnterUmsWorkingMode() and EnterUmsWorkingModeOnCpu().
+ */
+ums_t ums_create_worker(void *(*start_routine) (void *), void* arg, int cpu){
     ums_t id;
+    ums_worker* w = NULL;
+    working_wrapper_routine_arg* wrapper_arg;
+    ums_unpark_args args;
+    pthread_attr_t attr;
+    cpu_set_t set;
 
     //printf("Creating working thread.\n");
 
-    //update the counter, no need for locks here, it is done sequentially
-    worker_num += 1;
-    //printf("Current number of workers:%d\n", worker_num);
+    CPU_ZERO(&set);
+    if(cpu >= 0)
+        CPU_SET(cpu, &set);
+
+    if(ums_backend != UMS_BACKEND_KERNEL){
+        if(ums_backend == UMS_BACKEND_COROUTINE)
+            id = ums_co_create(start_routine, arg);
+        else
+            id = ums_fx_create(start_routine, arg);
+        if(!id){
+            printf("Could not create the worker! Aborting\n");
+            exit(UMS_ERROR_MEM);
+        }
+        if(cpu >= 0)
+            ums_pin_worker(id, &set);
+        return id;
+    }
 
-    working_wrapper_routine_arg* wrapper_arg = (working_wrapper_routine_arg*) malloc(sizeof(working_wrapper_routine_arg));
+    if(__atomic_load_n(&pool_max, __ATOMIC_RELAXED)){
+        //pooled workers are identified by a slot of the registry, since their thread outlives them
+        w = ums_worker_alloc();
+        if(!w){
+            printf("Could not create the worker! Aborting\n");
+            exit(UMS_ERROR_MEM);
+        }
+        w->start_routine = start_routine;
+        w->arg = arg;
+        w->retval = NULL;
+        w->state = UMS_CO_IDLE;
+        __atomic_store_n(&w->id, UMS_REGISTRY_ID(w), __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&pool_lock);
+        wrapper_arg = pool_parked;
+        if(wrapper_arg){
+            pool_parked = wrapper_arg->next_parked;
+            pool_parked_num--;
+        }
+        pthread_mutex_unlock(&pool_lock);
+
+        if(wrapper_arg){
+            //the parked thread keeps the CPUs of its last worker
+            if(cpu != wrapper_arg->cpu){
+                pthread_setaffinity_np(wrapper_arg->thread, sizeof(cpu_set_t), cpu >= 0 ? &set : &ums_all_cpus);
+                wrapper_arg->cpu = cpu;
+            }
+            w->thread = wrapper_arg->thread;
+
+            //the parked thread takes the id of the new worker and waits to be executed
+            wrapper_arg->task = w;
+            args.tid = wrapper_arg->tid;
+            args.ums_id = w->id;
+            DO_IOCTL(fd, UMS_WORKER_UNPARK, &args);
+            return w->id;
+        }
+    }
+
+    wrapper_arg = (working_wrapper_routine_arg*) malloc(sizeof(working_wrapper_routine_arg));
     wrapper_arg->start_routine = start_routine;
     wrapper_arg->arg = arg;
+    wrapper_arg->task = w;
+    wrapper_arg->cpu = cpu;
+    if(sem_init(&wrapper_arg->announced, 0, 0) == -1){
+        printf("Could not initialize the semaphore Aborting");
+        exit(UMS_ERROR_SEM);
+    }
 
-    pthread_create(&id, NULL, WorkingThreadWrapper, (void*) wrapper_arg);
+    ums_thread_attr(&attr, cpu);
+    //a pooled thread outlives its workers, which are joined through the registry: nobody joins the thread itself
+    if(w)
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if(pthread_create(&id, &attr, WorkingThreadWrapper, (void*) wrapper_arg)){
+        printf("Could not create the worker! Aborting\n");
+        exit(UMS_ERROR_THREAD);
+    }
+    pthread_attr_destroy(&attr);
+    //the thread does not park before it is announced, i.e. before this is set
+    wrapper_arg->thread = id;
+    if(w){
+        w->thread = id;
+        id = w->id;
+    }
+    else
+        ums_live_add(wrapper_arg);
+
+    //from now on the schedulers wait for the worker, even if it did not register yet
+    DO_IOCTL(fd, UMS_ANNOUNCE_TASK, &id);
+    sem_post(&wrapper_arg->announced);
 
     return id;
 }
@@ -181,20 +457,57 @@ ums_t EnterUmsWorkingMode(void *(*start_routine) (void *), void* arg){
  */
 
 void* WorkingThreadWrapper(void* arg){
-    int ret;
+    ums_worker* w;
 
     working_wrapper_routine_arg* wrapper_arg = (working_wrapper_routine_arg*) arg;
 
+    wrapper_arg->tid = syscall(SYS_gettid);
+    pool_task = wrapper_arg->task;
+
     ums_t ums_id = ums_get_id();
 
-    //update counter
-    sem_wait(&num_sem);
-    loaded_num += 1;
-    sem_post(&num_sem);
+    /*the worker registers only after it was announced, otherwise it could be executed and end before the announce,
+    which would then create an item for a worker that does not exist anymore
+    */
+    while(sem_wait(&wrapper_arg->announced) == -1){}
+    sem_destroy(&wrapper_arg->announced);
 
     DO_IOCTL(fd, INTRODUCE_UMS_TASK, &ums_id);
 
-    wrapper_arg->start_routine(wrapper_arg->arg);
+    if(!wrapper_arg->task){
+        wrapper_arg->start_routine(wrapper_arg->arg);
+        ums_live_remove(wrapper_arg);
+
+        DO_IOCTL(fd, UMS_WORKER_DONE, 0);
+
+        free(arg);
+        pthread_exit(0);
+    }
+
+    while(1){
+        w = wrapper_arg->task;
+        pool_task = w;
+        w->retval = w->start_routine(w->arg);
+
+        //w may be freed by its joiner as soon as it is marked as done
+        ums_worker_done(w);
+        ums_co_notify();
+
+        pthread_mutex_lock(&pool_lock);
+        if(pool_parked_num >= __atomic_load_n(&pool_max, __ATOMIC_RELAXED)){
+            pthread_mutex_unlock(&pool_lock);
+            break;
+        }
+        //the kernel module only unparks the threads that are marked, and the thread can be taken as soon as it is pushed
+        DO_IOCTL(fd, UMS_WORKER_PARKING, 0);
+        wrapper_arg->next_parked = pool_parked;
+        pool_parked = wrapper_arg;
+        pool_parked_num++;
+        pthread_mutex_unlock(&pool_lock);
+
+        //returns once the thread was given a new worker and a scheduler executed it
+        DO_IOCTL(fd, UMS_WORKER_PARK, 0);
+    }
 
     DO_IOCTL(fd, UMS_WORKER_DONE, 0);
 
@@ -212,6 +525,15 @@ void* WorkingThreadWrapper(void* arg){
 
 void ExecuteUmsThread(ums_t id){
 
+    if(ums_backend == UMS_BACKEND_COROUTINE){
+        ums_co_execute(id);
+        return;
+    }
+    if(ums_backend == UMS_BACKEND_FUTEX){
+        ums_fx_execute(id);
+        return;
+    }
+
     DO_IOCTL(fd, EXECUTE_UMS_THREAD, (unsigned long*) &id);
 }
 
@@ -222,52 +544,453 @@ void ExecuteUmsThread(ums_t id){
  */
 void UmsThreadYield(){
 
+    if(ums_backend == UMS_BACKEND_COROUTINE){
+        ums_co_yield();
+        return;
+    }
+    if(ums_backend == UMS_BACKEND_FUTEX){
+        ums_fx_yield();
+        return;
+    }
+
     DO_IOCTL(fd, UMS_THREAD_YIELD, 0);
 
 }
 
+/**
+ * @p next the id of the thread that needs to be executed
+ * 
+ * Called from a worker thread, pauses the execution and gives the control directly to the worker @p next, without
+ * going through the scheduler; @p next will give the control back to the scheduler of the caller when it yields.
+ * If @p next cannot be executed (e.g. it is already running, or it is over) this is the same as UmsThreadYield().
+ */
+void UmsThreadYieldTo(ums_t next){
+
+    if(ums_backend == UMS_BACKEND_COROUTINE){
+        ums_co_yield_to(next);
+        return;
+    }
+    if(ums_backend == UMS_BACKEND_FUTEX){
+        ums_fx_yield_to(next);
+        return;
+    }
+
+    DO_IOCTL(fd, UMS_THREAD_YIELD_TO, (unsigned long*) &next);
+
+}
+
+/**
+ * @p cs the completion list of the calling scheduler
+ * 
+ * Introduces the calling scheduler to the kernel module, with its completion list. The list is locked until the
+ * scheduler is registered, so that a thread added to it (or removed) in the meantime is either in the copy given to
+ * the kernel module or notified to it by ums_completion_list_changed().
+ */
+void ums_introduce_scheduler(completion_list* cs){
+    ums_introduce_args args;
+
+    sem_wait(&cs->sem);
+
+    unsigned long memory[cs->len + 1];
+    completion_list_copy(cs, memory, NULL, cs->len);
+
+    args.list = (unsigned long) memory;
+    args.key = (unsigned long) cs;
+    DO_IOCTL(fd, INTRODUCE_UMS_SCHEDULER, &args);
+    cs->registered = 1;
+
+    sem_post(&cs->sem);
+}
+
+/**
+ * @p cs the completion list that changed \n 
+ * @p ums_id the thread that was added or removed \n 
+ * @p added 1 if the thread was added, 0 if it was removed \n 
+ * 
+ * Called by completion_list_add() and completion_list_remove() (holding the semaphore of the list) once a scheduler
+ * introduced the list, so that the kernel module updates the worker lists of its schedulers.
+ */
+void ums_completion_list_changed(completion_list* cs, ums_t ums_id, int added){
+    ums_list_args args;
+
+    if(fd == -1)
+        return;
+
+    args.key = (unsigned long) cs;
+    args.ums_id = ums_id;
+    DO_IOCTL(fd, added ? UMS_LIST_ADD : UMS_LIST_REMOVE, &args);
+}
+
 /**
  * @p cs the complition list of the scheduler
  * 
  * This function returns a completion list of all ready thread to be executed among those which are present in the completion list
  * given in input. The returned list must be deleted by the user using the function completion_list_delete(), otherwise leaks
- * will occur.
+ * will occur. If no thread is ready, the caller sleeps in the kernel until one of them is; if none of the threads
+ * exists anymore, the returned list is empty.
  */
 completion_list* DequeueUmsCompletionListItems(completion_list* cs){
 
-    unsigned long memory[cs->len + 1];
-    memory[0] = cs->len;
-    int i;
+    return DequeueUmsCompletionListItemsEx(cs, 0, 0);
+}
+
+/**
+ * @p cs the complition list of the scheduler \n 
+ * @p flags UMS_DEQUEUE_NONBLOCK to return immediately if no thread is ready, 0 otherwise \n 
+ * @p timeout maximum time (in ms) to wait for a thread to be ready, 0 to wait forever \n 
+ * 
+ * Same as DequeueUmsCompletionListItems(), but the wait for a ready thread can be bounded. NULL is returned if no
+ * thread got ready in time (or immediately, with UMS_DEQUEUE_NONBLOCK) while some of them still exist; an empty list
+ * is still returned when none of the threads exists anymore.
+ */
+completion_list* DequeueUmsCompletionListItemsEx(completion_list* cs, int flags, unsigned long timeout){
 
-    completion_list_item* item = cs->head;
-    completion_list_item* aux;
+    //the list may grow while it is copied, only the threads counted here are considered
+    int max = __atomic_load_n(&cs->len, __ATOMIC_RELAXED);
+    unsigned long memory[max + 1];
+    int prio[max];
+    int i, len;
 
-    sem_wait(&cs->sem);
+    len = completion_list_copy(cs, memory, prio, max);
 
-    for(i = 1; i<=cs->len; i++){
+    if(ums_dequeue_ready(memory, len, flags, timeout) == -1)
+        return NULL;
 
-        memory[i] = item->ums_id;
+    completion_list* ready = completion_list_create();
 
-        item = item->next;
+    for(i = 1; i<=len; i++){
+        if(memory[i]){
+            completion_list_add(ready, memory[i], prio[i - 1]);
+        }
     }
-    sem_post(&cs->sem);
 
-    DO_IOCTL(fd, UMS_DEQUEUE, &memory);
+    return ready;
+}
 
-    completion_list* ready = completion_list_create();
-    
-    item = cs->head;
+/**
+ * @p cs the complition list of the scheduler \n 
+ * @p ready the array in which the ids of the ready threads are saved \n 
+ * @p prio the array in which their priorities are saved, NULL if they are not needed \n 
+ * @p max the length of @p ready (and @p prio) \n 
+ * @p flags UMS_DEQUEUE_NONBLOCK to return immediately if no thread is ready, 0 otherwise \n 
+ * @p timeout maximum time (in ms) to wait for a thread to be ready, 0 to wait forever \n 
+ * 
+ * Same as DequeueUmsCompletionListItemsEx(), but the ready threads are saved in the arrays owned by the caller (in the
+ * order of the completion list), thus nothing is allocated and nothing has to be freed; the arrays can be reused for
+ * all the decisions of the scheduler. Only the first @p max threads of @p cs are considered, so @p max should be at
+ * least the length of @p cs. Returns the number of ready threads, 0 if none of the threads exists anymore, -1 if no
+ * thread got ready in time.
+ */
+int DequeueUmsCompletionListItemsBuffer(completion_list* cs, ums_t* ready, int* prio, int max, int flags, unsigned long timeout){
+
+    //the list may grow while it is copied, only the threads counted here are considered
+    int len, i, n = 0, cap = __atomic_load_n(&cs->len, __ATOMIC_RELAXED);
+
+    if(cap > max)
+        cap = max;
 
-    for(i = 1; i<=cs->len; i++){    
-        //printf("Mem[%d]=%lu", i, memory[i]);
+    unsigned long memory[cap + 1];
+    int prio_all[cap];
+
+    len = completion_list_copy(cs, memory, prio_all, cap);
+
+    if(ums_dequeue_ready(memory, len, flags, timeout) == -1)
+        return -1;
+
+    for(i = 1; i<=len; i++){
         if(memory[i]){
-            completion_list_add(ready, memory[i], item->prio);
+            ready[n] = memory[i];
+            if(prio)
+                prio[n] = prio_all[i - 1];
+            n++;
         }
-        item = item->next;
     }
-    //printf("\n");
 
-    return ready;
+    return n;
+}
+
+/**
+ * @p memory the ids of the completion list, preceded by its length (memory[0]) \n 
+ * @p len the length of the completion list \n 
+ * @p flags UMS_DEQUEUE_NONBLOCK to return immediately if no thread is ready, 0 otherwise \n 
+ * @p timeout maximum time (in ms) to wait for a thread to be ready, 0 to wait forever \n 
+ * 
+ * Core of the dequeue functions: the ids of the threads that are not ready are set to 0 in @p memory. Returns -1 if
+ * no thread got ready in time while some of them still exist, 0 otherwise.
+ */
+int ums_dequeue_ready(unsigned long* memory, int len, int flags, unsigned long timeout){
+    int ret;
+    ums_dequeue_args args;
+
+    //the threads may be added later, but for now there is none
+    if(!len)
+        return 0;
+
+    if(ums_backend != UMS_BACKEND_KERNEL)
+        return ums_co_dequeue(memory + 1, memory + 1, len, flags, timeout) == -EAGAIN ? -1 : 0;
+
+    args.list = (unsigned long) memory;
+    args.flags = flags;
+    args.timeout = timeout;
+
+    //a signal handler may interrupt the wait, in that case we simply wait again
+    do{
+        ret = ioctl(fd, UMS_DEQUEUE_EX, &args);
+    }while(ret == -1 && errno == EINTR);
+
+    if(ret == -1){
+        if(errno == EAGAIN)
+            return -1;
+        printf("Could not perform ioctl! Aborting\n");
+        exit(UMS_ERROR_IOCTL);
+    }
+
+    return 0;
+}
+
+/**
+ * @p cs the complition list of the scheduler \n 
+ * @p ready the heap in which the ready threads are saved \n 
+ * @p flags UMS_DEQUEUE_NONBLOCK to return immediately if no thread is ready, 0 otherwise \n 
+ * @p timeout maximum time (in ms) to wait for a thread to be ready, 0 to wait forever \n 
+ * 
+ * Same as DequeueUmsCompletionListItemsEx(), but the ready threads are kept in @p ready ordered by priority, so that
+ * the next thread to be executed is taken with ums_heap_pop() instead of walking a new list. The heap is kept across
+ * the calls and only the changes are applied: the threads that got ready are pushed, the ones whose prio changed are
+ * moved and the ones that are not ready anymore (or not in @p cs anymore) are removed, thus the threads that did not
+ * change cost no heap operation; no memory is allocated once the heap is big enough. The heap should be created by
+ * the scheduler with ums_heap_create() and reused for all its decisions. Returns the number of ready threads, 0 if
+ * none of the threads exists anymore, -1 if no thread got ready in time.
+ */
+int DequeueUmsCompletionListHeap(completion_list* cs, ums_heap* ready, int flags, unsigned long timeout){
+
+    //the list may grow while it is copied, only the threads counted here are considered
+    int max = __atomic_load_n(&cs->len, __ATOMIC_RELAXED);
+    unsigned long memory[max + 1];
+    ums_t ids[max];
+    int prio[max];
+    int i, len, n = 0;
+
+    len = completion_list_copy(cs, memory, prio, max);
+    //the kernel overwrites the ids of the threads that are not ready
+    memcpy(ids, memory + 1, len * sizeof(ums_t));
+
+    if(ums_dequeue_ready(memory, len, flags, timeout) == -1)
+        return -1;
+
+    ums_heap_new_round(ready);
+    for(i = 1; i<=len; i++){
+        if(!memory[i]){
+            ums_heap_remove(ready, ids[i - 1]);
+            continue;
+        }
+        //a thread that is already in the heap with the same prio does not move
+        if(ums_heap_push(ready, memory[i], prio[i - 1]) == -1){
+            printf("Could not allocate the heap! Aborting\n");
+            exit(UMS_ERROR_MEM);
+        }
+        n++;
+    }
+    //threads removed from the list are neither ready nor not ready, they are the only ones left from older rounds
+    if(ums_heap_len(ready) != n)
+        ums_heap_prune(ready);
+
+    return ums_heap_len(ready);
+}
+
+/**
+ * @p cs the complition list of the scheduler \n 
+ * @p policy UMS_POLICY_FIRST_READY or UMS_POLICY_LOWEST_PRIO \n 
+ * 
+ * Called from a scheduler thread, this function is the same as calling DequeueUmsCompletionListItems() and then
+ * ExecuteUmsThread() on one of the ready threads, but it is done with a single request to the kernel module.
+ * With UMS_POLICY_FIRST_READY the first ready thread of @p cs is executed, with UMS_POLICY_LOWEST_PRIO the ready thread
+ * with the lowest prio field (the first one, in case of ties). The scheduler remains blocked until the thread yields,
+ * or ends. The id of the executed thread is returned; 0 is returned if none of the threads in @p cs exists anymore.
+ */
+ums_t DequeueAndExecuteUmsThread(completion_list* cs, int policy){
+
+    //the list may grow while it is copied, only the threads counted here are considered
+    int max = __atomic_load_n(&cs->len, __ATOMIC_RELAXED);
+    unsigned long memory[max + 1];
+    int prio[max];
+    int ret, len;
+    ums_dequeue_exec_args args;
+
+    len = completion_list_copy(cs, memory, prio, max);
+    if(!len)
+        return 0;
+
+    if(ums_backend == UMS_BACKEND_COROUTINE)
+        return ums_co_dequeue_execute(memory + 1, prio, len, policy, ums_co_execute);
+    if(ums_backend == UMS_BACKEND_FUTEX)
+        return ums_co_dequeue_execute(memory + 1, prio, len, policy, ums_fx_execute);
+
+    args.list = (unsigned long) memory;
+    args.prio = (unsigned long) prio;
+    args.policy = policy;
+    args.flags = 0;
+    args.timeout = 0;
+    args.executed = 0;
+
+    //a signal handler may interrupt the wait, in that case we simply wait again
+    do{
+        ret = ioctl(fd, UMS_DEQUEUE_AND_EXECUTE, &args);
+    }while(ret == -1 && errno == EINTR);
+
+    if(ret == -1){
+        printf("Could not perform ioctl! Aborting\n");
+        exit(UMS_ERROR_IOCTL);
+    }
+
+    return args.executed;
+}
+
+/**
+ * @p own the deque of the scheduler \n 
+ * @p cs the completion list of the scheduler \n 
+ * 
+ * Moves the ready threads of @p cs in @p own, in reverse order so that the owner takes them in the order of the list
+ * and the thieves steal the last ones; it does not wait. Returns the first ready thread (that is not pushed), 0 if
+ * none is ready.
+ */
+static ums_t ums_steal_refill(ums_deque* own, completion_list* cs){
+    int i, n, max = __atomic_load_n(&cs->len, __ATOMIC_RELAXED);
+    ums_t ready[max + 1];
+
+    n = DequeueUmsCompletionListItemsBuffer(cs, ready, NULL, max, UMS_DEQUEUE_NONBLOCK, 0);
+    if(n <= 0)
+        return 0;
+
+    //if the deque cannot grow the thread is simply left in the list, it is found again by the next refill
+    for(i = n - 1; i > 0; i--)
+        ums_deque_push(own, ready[i]);
+
+    return ready[0];
+}
+
+/**
+ * @p group the steal group of the scheduler \n 
+ * @p slot the slot of the scheduler in @p group \n 
+ * 
+ * Looks at all the lists of @p group in a single dequeue with no timeout, the own list first: this finds the ready
+ * threads of the siblings that are busy running a thread (and did not refill their deques yet), and if there are none
+ * the scheduler sleeps in the kernel module (or in the user space backend) until a worker of the process yields,
+ * instead of polling the lists. Returns the first ready thread, 0 if none of the threads of the group exists anymore.
+ */
+static ums_t ums_steal_wait(ums_steal_group* group, int slot){
+    //the siblings may join the group later
+    int len = __atomic_load_n(&group->len, __ATOMIC_ACQUIRE);
+    int i, n, copied, total = 0;
+    int max[len];
+    unsigned long last;
+
+    for(i = 0; i < len; i++){
+        max[i] = __atomic_load_n(&group->lists[(slot + i) % len]->len, __ATOMIC_RELAXED);
+        total += max[i];
+    }
+    unsigned long memory[total + 1];
+
+    //each list is copied right after the previous one, thus its length overwrites the last id of the previous one
+    memory[0] = 0;
+    for(i = 0, n = 0; i < len; i++){
+        last = memory[n];
+        copied = completion_list_copy(group->lists[(slot + i) % len], memory + n, NULL, max[i]);
+        memory[n] = last;
+        n += copied;
+    }
+    memory[0] = n;
+
+    //with no timeout it returns only once a thread is ready, or once none of them exists
+    ums_dequeue_ready(memory, n, 0, 0);
+    for(i = 1; i <= n; i++)
+        if(memory[i])
+            return memory[i];
+
+    return 0;
+}
+
+/**
+ * @p group the steal group of the scheduler \n 
+ * @p slot the slot of the scheduler in @p group, as returned by ums_steal_group_add() \n 
+ * 
+ * Called from a scheduler thread that has a private completion list, but shares the work with the other schedulers
+ * of @p group; returns the next thread to be executed with ExecuteUmsThread(). The ready threads of its own list are
+ * taken first, through the deque of the scheduler; when there are none the scheduler steals from the deques of its
+ * siblings, and then looks at the lists of the siblings that are busy running a thread. A thread of another list is
+ * executed like the others: the kernel module moves it to the scheduler that executes it (counting a steal in the
+ * statistics of that scheduler), and it goes back to the list of its owner when it yields. \n 
+ * If no thread is ready the scheduler sleeps until a thread of any list of the group is ready (see ums_steal_wait()),
+ * since every worker that yields wakes up the sleeping schedulers. 0 is returned once none of the threads of the group
+ * exists anymore.
+ */
+ums_t DequeueUmsThreadSteal(ums_steal_group* group, int slot){
+    ums_deque* own = &group->deques[slot];
+    ums_t id;
+    int i, len;
+
+    id = ums_deque_take(own);
+    if(id)
+        return id;
+
+    id = ums_steal_refill(own, group->lists[slot]);
+    if(id)
+        return id;
+
+    //the siblings may join the group later
+    len = __atomic_load_n(&group->len, __ATOMIC_ACQUIRE);
+
+    for(i = 1; i < len; i++){
+        do{
+            id = ums_deque_steal(&group->deques[(slot + i) % len]);
+        }while(id == UMS_DEQUE_ABORT);
+        if(id)
+            return id;
+    }
+
+    //a thread that is ready but was not pushed in a deque is claimed by whoever executes it first
+    return ums_steal_wait(group, slot);
+}
+
+/**
+ * @p ids the array in which the ids of the ready threads are saved \n 
+ * @p max the length of @p ids \n 
+ * 
+ * Called from a scheduler thread, this function saves in @p ids (at most @p max of) the threads of its completion list
+ * that got ready since the last call, and returns how many they are. The ids are read from a ring shared with the
+ * kernel module, thus no system call is issued; executing one of them is still done with ExecuteUmsThread(). \n 
+ * An id is only a hint: the thread may have been executed by another scheduler in the meantime, in that case
+ * ExecuteUmsThread() simply returns. -1 is returned if the ring is not available or if some ids were lost because the
+ * ring was full; in both cases the scheduler has to use DequeueUmsCompletionListItems() to find the ready threads.
+ * 0 is returned if no thread got ready: the ring does not tell whether the threads are over, so before exiting
+ * (or to sleep until a thread is ready) the scheduler has to use DequeueUmsCompletionListItems() as well.
+ */
+int DequeueUmsReadyRingItems(ums_t* ids, int max){
+    unsigned long head, tail;
+    int n = 0;
+
+    //the ring is only mapped by the kernel backend (ready_ring is always NULL otherwise)
+    if(!ready_ring)
+        return -1;
+
+    if(__atomic_load_n(&ready_ring->overflow, __ATOMIC_RELAXED)){
+        __atomic_store_n(&ready_ring->overflow, 0, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    tail = ready_ring->tail;
+    //pairs with the release done by the kernel after it has written the slots
+    head = __atomic_load_n(&ready_ring->head, __ATOMIC_ACQUIRE);
+
+    while(tail != head && n < max){
+        ids[n++] = ready_ring->ids[tail & (UMS_RING_SIZE - 1)];
+        tail++;
+    }
+
+    //the slots we read can now be reused by the kernel
+    __atomic_store_n(&ready_ring->tail, tail, __ATOMIC_RELEASE);
+
+    return n;
 }
 
 /**
@@ -277,7 +1000,14 @@ completion_list* DequeueUmsCompletionListItems(completion_list* cs){
  * Waits for the completion of the execution of the given thread.
  */
 int ums_thread_join(ums_t thread, void **retval){
-    return pthread_join(thread, retval);
+
+    if(ums_backend == UMS_BACKEND_COROUTINE)
+        return ums_co_join(thread, retval);
+    if(ums_backend == UMS_BACKEND_FUTEX)
+        return ums_fx_join(thread, retval);
+
+    //pooled workers are found in the registry, the others are plain threads
+    return ums_co_join(thread, retval);
 }
 /**
  * @fn ums_get_id
@@ -285,5 +1015,61 @@ int ums_thread_join(ums_t thread, void **retval){
  * Returns the id of the caller thread.
  */
 ums_t ums_get_id(){
+    ums_t id;
+
+    if(ums_backend != UMS_BACKEND_KERNEL){
+        id = ums_co_self();
+        if(id)
+            return id;
+    }
+    else if(pool_task)
+        return pool_task->id;
+
     return pthread_self();
-}
\ No newline at end of file
+}
+
+/**
+ * @p max the maximum number of idle worker threads kept in the pool, 0 disables the pool
+ * 
+ * Enables the pool of worker threads (kernel backend only). When the function of a worker returns, its thread is not
+ * destroyed but parked in the kernel module, still registered; the next EnterUmsWorkingMode() hands the new function
+ * to a parked thread, which costs a single request to the kernel module instead of a thread creation and a
+ * registration. The IDs of pooled workers are not pthread IDs: use ums_thread_join() and ums_get_id() with them.
+ * Should be called before creating the workers. Returns -1 if the backend does not support the pool.
+ */
+int ums_set_worker_pool(int max){
+
+    if(ums_backend != UMS_BACKEND_KERNEL || max < 0)
+        return -1;
+
+    __atomic_store_n(&pool_max, max, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * @p mode UMS_SWITCH_WAKEUP (the default) or UMS_SWITCH_SAME_CPU
+ * 
+ * Sets how the schedulers of the process give the CPU to their workers (kernel backend). With UMS_SWITCH_SAME_CPU the
+ * kernel module wakes each executed worker up on the CPU of its scheduler and the scheduler yields the core to it,
+ * instead of letting the kernel wake it up wherever it likes; the workers pinned by the user (e.g. with
+ * EnterUmsWorkingModeOnCpu()) keep their CPUs, and the other ones get the CPUs of the process back once the mode is
+ * UMS_SWITCH_WAKEUP again. With the
+ * coroutine backend the switches already happen on the thread of the scheduler, thus nothing has to be done. Returns
+ * -1 if the mode is unknown, if the backend does not support it or if the kernel module refused it.
+ */
+int ums_set_switch_mode(int mode){
+
+    if(mode != UMS_SWITCH_WAKEUP && mode != UMS_SWITCH_SAME_CPU)
+        return -1;
+    if(ums_backend == UMS_BACKEND_COROUTINE)
+        return 0;
+    if(ums_backend != UMS_BACKEND_KERNEL)
+        return -1;
+
+    //not DO_IOCTL(), which does not pass a zero argument (UMS_SWITCH_WAKEUP)
+    if(ioctl(fd, UMS_SWITCH_MODE, (unsigned long) mode) == -1)
+        return -1;
+
+    return 0;
+}
@@ -4,6 +4,9 @@
  * 
  * Main definitions and functionalities of the user-side library for UMS scheduling
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             //CPU affinity of the threads
+#endif
 #include <stdio.h>
 #include <pthread.h>
 #include <stdlib.h>
@@ -11,8 +14,13 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <semaphore.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <stdint.h>
 
 #include "UMSList.h"
+#include "UMSHeap.h"
+#include "UMSSteal.h"
 
 
 
@@ -24,11 +32,35 @@
 #define UMS_THREAD_YIELD            6
 #define UMS_WORKER_DONE             7
 #define UMS_DEQUEUE                 8
+#define UMS_DEQUEUE_EX              9
+#define UMS_THREAD_YIELD_TO         10
+#define UMS_DEQUEUE_AND_EXECUTE     11
+#define UMS_ACCOUNT_SWITCHES        12
+#define UMS_LIST_ADD                13
+#define UMS_LIST_REMOVE             14
+#define UMS_ANNOUNCE_TASK           15
+#define UMS_WORKER_PARK             16
+#define UMS_WORKER_UNPARK           17
+#define UMS_SWITCH_MODE             18
+#define UMS_WORKER_PARKING          19
+
+//flags of DequeueUmsCompletionListItemsEx
+#define UMS_DEQUEUE_NONBLOCK        1
+
+//policies of DequeueAndExecuteUmsThread
+#define UMS_POLICY_FIRST_READY      0
+#define UMS_POLICY_LOWEST_PRIO      1
+
+//modes of ums_set_switch_mode
+#define UMS_SWITCH_WAKEUP           0
+#define UMS_SWITCH_SAME_CPU         1
 
 #define UMS_ERROR_INIT              -1
 #define UMS_ERROR_IOCTL             -2
 #define UMS_ERROR_SEM               -3
 #define UMS_ERROR_FD                -4
+#define UMS_ERROR_MEM               -5
+#define UMS_ERROR_THREAD            -6
 
 #define DEVICE_NAME "ums-dev"
 #define DEVICE_FOLDER "/dev/"
@@ -56,6 +88,112 @@ do{\
 
 typedef pthread_t ums_t;
 
+//buckets of the set of the live worker threads (see ums_pin_worker())
+#define UMS_LIVE_BUCKETS            256
+#define UMS_LIVE_HASH(id)           (((unsigned long) (id) * 0x9e3779b97f4a7c15UL) >> 56)
+
+//number of slots of the ready ring of a scheduler, same value of the kernel module
+#define UMS_RING_SIZE               256
+
+/**
+ * for internal use only, ring of ready workers shared with the kernel module (see common.h in the module)
+ */
+typedef struct ums_ready_ring{
+    unsigned long head;
+    unsigned long pad0[7];
+    unsigned long tail;
+    unsigned long pad1[7];
+    unsigned long overflow;
+    unsigned long pad2[7];
+    unsigned long ids[UMS_RING_SIZE];
+}ums_ready_ring;
+
+//layout of /proc/ums/<pid>/stats, same values of the kernel module (see common.h in the module)
+#define UMS_STATS_MAGIC             0x53534d55      //"UMSS"
+#define UMS_STATS_VERSION           2
+
+/**
+ * header of /proc/ums/<pid>/stats: for every scheduler, a ums_stats_sched record follows, with the ums_stats_worker
+ * records of its workers after it; check magic and version before reading the records
+ */
+typedef struct ums_stats_header{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_sched;
+    uint32_t num_workers;
+}ums_stats_header;
+
+/**
+ * record of a scheduler in /proc/ums/<pid>/stats, times are in ns and running is -1 if no worker is running
+ */
+typedef struct ums_stats_sched{
+    uint64_t id;
+    uint64_t switches;
+    uint64_t total_time;
+    uint64_t last_time;
+    int64_t running;
+    uint64_t steals;
+    uint32_t state;
+    uint32_t worker_num;
+}ums_stats_sched;
+
+/**
+ * record of a worker in /proc/ums/<pid>/stats
+ */
+typedef struct ums_stats_worker{
+    uint64_t ums_id;
+    uint64_t switches;
+    uint32_t id;
+    uint32_t state;
+}ums_stats_worker;
+
+/**
+ * for internal use only, argument of UMS_DEQUEUE_EX
+ */
+typedef struct ums_dequeue_args{
+    unsigned long list;
+    unsigned long flags;
+    unsigned long timeout;
+}ums_dequeue_args;
+
+/**
+ * for internal use only, argument of UMS_DEQUEUE_AND_EXECUTE
+ */
+typedef struct ums_dequeue_exec_args{
+    unsigned long list;
+    unsigned long prio;
+    unsigned long policy;
+    unsigned long flags;
+    unsigned long timeout;
+    unsigned long executed;
+}ums_dequeue_exec_args;
+
+/**
+ * for internal use only, argument of INTRODUCE_UMS_SCHEDULER
+ */
+typedef struct ums_introduce_args{
+    unsigned long list;
+    unsigned long key;
+}ums_introduce_args;
+
+/**
+ * for internal use only, argument of UMS_LIST_ADD and UMS_LIST_REMOVE
+ */
+typedef struct ums_list_args{
+    unsigned long key;
+    unsigned long ums_id;
+}ums_list_args;
+
+/**
+ * for internal use only, argument of UMS_WORKER_UNPARK
+ */
+typedef struct ums_unpark_args{
+    unsigned long tid;
+    unsigned long ums_id;
+}ums_unpark_args;
+
+#include "UMSUserBackend.h"
+
 /**
  * for internal use only
  */
@@ -63,6 +201,13 @@ typedef struct working_wrapper_routine_arg{
     void *(*start_routine) (void *);
     void* arg;
     int fd;
+    sem_t announced;
+    pthread_t thread;
+    int cpu;
+    struct ums_worker* task;
+    pid_t tid;
+    struct working_wrapper_routine_arg* next_parked;
+    struct working_wrapper_routine_arg* next_live;
 }working_wrapper_routine_arg;
 
 /**
@@ -82,12 +227,32 @@ void UMS_exit(void);
 //user interface
 ums_t EnterUmsSchedulingMode(void*, void *(*start_routine) (completion_list *, void *), void* );
 ums_t EnterUmsWorkingMode(void *(*start_routine) (void *), void* );
+ums_t EnterUmsSchedulingModeOnCpu(void*, void *(*start_routine) (completion_list *, void *), void*, int);
+ums_t EnterUmsWorkingModeOnCpu(void *(*start_routine) (void *), void*, int);
 void ExecuteUmsThread(ums_t);
 void UmsThreadYield(void);
+void UmsThreadYieldTo(ums_t);
 completion_list* DequeueUmsCompletionListItems(completion_list*);
+completion_list* DequeueUmsCompletionListItemsEx(completion_list*, int, unsigned long);
+int DequeueUmsCompletionListItemsBuffer(completion_list*, ums_t*, int*, int, int, unsigned long);
+int DequeueUmsCompletionListHeap(completion_list*, ums_heap*, int, unsigned long);
+int DequeueUmsReadyRingItems(ums_t*, int);
+ums_t DequeueAndExecuteUmsThread(completion_list*, int);
+ums_t DequeueUmsThreadSteal(ums_steal_group*, int);
 int ums_thread_join(ums_t thread, void **retval);
 ums_t ums_get_id(void);
+int ums_set_worker_pool(int);
+int ums_set_switch_mode(int);
+
 
+//internals
+ums_t ums_create_scheduler(void*, void *(*start_routine) (completion_list *, void *), void*, int);
+ums_t ums_create_worker(void *(*start_routine) (void *), void*, int);
+void ums_thread_attr(pthread_attr_t*, int);
+void ums_live_add(working_wrapper_routine_arg*);
+void ums_live_remove(working_wrapper_routine_arg*);
+int ums_dequeue_ready(unsigned long*, int, int, unsigned long);
+void ums_introduce_scheduler(completion_list*);
 
 //wrappers
 void* WorkingThreadWrapper(void*);
@@ -1,5 +1,17 @@
 #include "UMSList.h"
 
+#define COMPLETION_LIST_MIN_CAPACITY    16
+//tries of a reader that finds a writer in the middle of a change, before it gives the CPU back
+#define COMPLETION_LIST_SPIN            64
+
+static inline void completion_list_write_begin(completion_list* cs){
+    __atomic_store_n(&cs->seq, cs->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void completion_list_write_end(completion_list* cs){
+    __atomic_store_n(&cs->seq, cs->seq + 1, __ATOMIC_RELEASE);
+}
 
 /**
  * @fn completion_list_create
@@ -7,7 +19,7 @@
  * Created an empty completion list. The completion list has to be deleted using the function completion_list_delete()
  * in order to avoid memory leaks. If more than a scheduler is using the same completion list, be carefull not to
  * delete it before every scheduler is done, otherwise it will lead to unpredictable behaviours of the program.
- * Accesses to the list are controlled by semaphores.
+ * Changes to the list are serialized by a semaphore, while the schedulers read it without any lock.
  */
 completion_list* completion_list_create(){
     int ret;
@@ -18,6 +30,11 @@ completion_list* completion_list_create(){
     cs->head = NULL;
     cs->tail = NULL;
     cs->len = 0;
+    cs->seq = 0;
+    cs->array = NULL;
+    cs->registered = 0;
+    CPU_ZERO(&cs->cpus);
+    cs->pinned = 0;
 
     ret = sem_init(&(cs->sem), 0, 1);
     if(ret == -1){
@@ -40,6 +57,8 @@ void completion_list_delete(completion_list* cs){
 
     completion_list_item* item = cs->head;
     completion_list_item* aux;
+    completion_list_array* array = cs->array;
+    completion_list_array* retired;
 
     while(item){
         //printf("Freeing item %p\n", item);
@@ -54,13 +73,51 @@ void completion_list_delete(completion_list* cs){
         exit(-3);
     }
 
+    while(array){
+        retired = array->retired;
+        free(array);
+        array = retired;
+    }
+
     free(cs);
 }
 
+/**
+ * @p cs the completion list \n 
+ * 
+ * Replaces the array of @p cs with one twice as big; the caller holds the semaphore. The old array is not freed,
+ * since a reader may still be copying it.
+ */
+static void completion_list_grow(completion_list* cs){
+    completion_list_array* old = cs->array;
+    completion_list_array* array;
+    int capacity = old ? 2 * old->capacity : COMPLETION_LIST_MIN_CAPACITY;
+
+    array = (completion_list_array*) malloc(sizeof(completion_list_array) + capacity * (sizeof(unsigned long) + sizeof(int)));
+    if(!array){
+        printf("Could not allocate the completion list, Aborting");
+        exit(-5);
+    }
+    array->retired = old;
+    array->capacity = capacity;
+    array->prios = (int*) &array->ids[capacity];
+
+    if(old){
+        memcpy(array->ids, old->ids, cs->len * sizeof(unsigned long));
+        memcpy(array->prios, old->prios, cs->len * sizeof(int));
+    }
+
+    //the content is the same, the readers can use either of them
+    __atomic_store_n(&cs->array, array, __ATOMIC_RELEASE);
+}
+
 void completion_list_append(completion_list* cs, completion_list_item* item){
 
     sem_wait(&cs->sem);
 
+    if(!cs->array || cs->len == cs->array->capacity)
+        completion_list_grow(cs);
+
     //first item
     if(cs->head == NULL){
         fflush(stdout);
@@ -78,7 +135,19 @@ void completion_list_append(completion_list* cs, completion_list_item* item){
 
     }
 
-    cs->len += 1;
+    completion_list_write_begin(cs);
+    cs->array->ids[cs->len] = item->ums_id;
+    cs->array->prios[cs->len] = item->prio;
+    __atomic_store_n(&cs->len, cs->len + 1, __ATOMIC_RELAXED);
+    completion_list_write_end(cs);
+
+    //still holding the semaphore, so that a scheduler that is introducing the list either sees the item or is told
+    if(cs->registered)
+        ums_completion_list_changed(cs, item->ums_id, 1);
+
+    //the thread follows the schedulers of the list
+    if(cs->pinned)
+        ums_pin_worker(item->ums_id, &cs->cpus);
 
     sem_post(&cs->sem);
 
@@ -90,6 +159,7 @@ void completion_list_append(completion_list* cs, completion_list_item* item){
  * @p prio the priority of the element that needs to be added
  * 
  * Adds an element to the tail of the given completion list; uses the function completion_list_append which is not exposed.
+ * The element can be added at any time, even after a scheduler started using the list.
  */
 void completion_list_add(completion_list* cs, ums_t ums_id, int prio){
 
@@ -103,6 +173,98 @@ void completion_list_add(completion_list* cs, ums_t ums_id, int prio){
 }
 
 
+/**
+ * @p cs the completion list \n 
+ * @p ums_id the id of the element that needs to be removed \n 
+ * 
+ * Removes an element from the given completion list (the first one with that id), so that the schedulers using the list
+ * do not consider it anymore; it can be called at any time. Returns -1 if the element is not in the list.
+ */
+int completion_list_remove(completion_list* cs, ums_t ums_id){
+    completion_list_item* item;
+    int i;
+
+    sem_wait(&cs->sem);
+
+    for(item = cs->head; item && item->ums_id != ums_id; item = item->next){}
+    if(!item){
+        sem_post(&cs->sem);
+        return -1;
+    }
+
+    if(item->prev)
+        item->prev->next = item->next;
+    else
+        cs->head = item->next;
+    if(item->next)
+        item->next->prev = item->prev;
+    else
+        cs->tail = item->prev;
+
+    for(i = 0; cs->array->ids[i] != ums_id; i++){}
+
+    completion_list_write_begin(cs);
+    memmove(&cs->array->ids[i], &cs->array->ids[i + 1], (cs->len - i - 1) * sizeof(unsigned long));
+    memmove(&cs->array->prios[i], &cs->array->prios[i + 1], (cs->len - i - 1) * sizeof(int));
+    __atomic_store_n(&cs->len, cs->len - 1, __ATOMIC_RELAXED);
+    completion_list_write_end(cs);
+
+    if(cs->registered)
+        ums_completion_list_changed(cs, ums_id, 0);
+
+    sem_post(&cs->sem);
+
+    free(item);
+
+    return 0;
+}
+
+/**
+ * @p cs the completion list \n 
+ * @p ids where the ids are copied, preceded by their number (ids[0]); it must have @p max + 1 slots \n 
+ * @p prio where the priorities are copied, NULL if they are not needed \n 
+ * @p max maximum number of items to be copied \n 
+ * 
+ * Copies (at most @p max of) the items of the list in flat arrays, and returns how many they are. The copy is taken
+ * from the contiguous array of the list without taking its semaphore, so the readers never block each other (nor
+ * wait for a writer that is sleeping on the semaphore); if the list changed during the copy, it is simply taken
+ * again. A reader that finds a writer in the middle of a change yields the CPU after a few tries, since the writer
+ * may have been preempted there.
+ */
+int completion_list_copy(completion_list* cs, unsigned long* ids, int* prio, int max){
+    completion_list_array* array;
+    unsigned int seq;
+    int len, spin = 0;
+
+    while(1){
+        seq = __atomic_load_n(&cs->seq, __ATOMIC_ACQUIRE);
+        //a change is short, but if the writer was preempted in the middle spinning would burn the whole time slice
+        if(seq & 1){
+            if(++spin == COMPLETION_LIST_SPIN){
+                spin = 0;
+                sched_yield();
+            }
+            continue;
+        }
+
+        array = __atomic_load_n(&cs->array, __ATOMIC_ACQUIRE);
+        len = __atomic_load_n(&cs->len, __ATOMIC_RELAXED);
+        if(len > max)
+            len = max;
+        if(len){
+            memcpy(ids + 1, array->ids, len * sizeof(unsigned long));
+            if(prio)
+                memcpy(prio, array->prios, len * sizeof(int));
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&cs->seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+    ids[0] = len;
+
+    return len;
+}
 
 
 /**
@@ -2,10 +2,15 @@
  * @file UMSList.h
  * @brief Manage the completion lists used by the user.
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             //cpu_set_t
+#endif
+#include <sched.h>
 #include <stdio.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdlib.h>
+#include <string.h>
 
 typedef pthread_t ums_t;
 
@@ -22,17 +27,50 @@ typedef struct completion_list_item{
     int prio;
 }completion_list_item;
 
+/**
+ * @p retired the array that was replaced by this one, it is freed together with the list \n 
+ * @p capacity number of slots of @p ids and @p prios \n 
+ * @p prios the priorities of the items \n 
+ * @p ids the ids of the items \n 
+ * 
+ * Contiguous copy of a completion list. When it is full a new one, twice as big, replaces it; the old one can still
+ * be read by a concurrent reader, thus it is only freed when the list is deleted (the retired arrays take less
+ * memory than the current one).
+ */
+typedef struct completion_list_array{
+    struct completion_list_array* retired;
+    int capacity;
+    int* prios;
+    unsigned long ids[];
+}completion_list_array;
+
 /**
  * @p head first item of the list \n 
  * @p tail last item of the list \n 
  * @p len length of the list \n 
- * @p semaphore used to access the list \n 
+ * @p semaphore serializes the writers of the list \n 
+ * @p seq sequence counter of the writers, odd while one of them is changing @p array or @p len \n 
+ * @p array contiguous copy of the ids and priorities of the list \n 
+ * @p registered set once a scheduler introduced the list to the kernel module, from then on the changes of the list
+ * are notified to it \n 
+ * @p cpus the CPUs of the pinned schedulers of the list (see EnterUmsSchedulingModeOnCpu()), the threads of the list
+ * are pinned to them \n 
+ * @p pinned set once a pinned scheduler uses the list \n 
+ * 
+ * The linked items are kept for the users that walk the list; the library only reads @p array, through
+ * completion_list_copy(), which never takes the semaphore: it copies the array and retries if a writer changed it in
+ * the meantime.
  */
 typedef struct completion_list{
     completion_list_item* head;
     completion_list_item* tail;
     int len;
     sem_t sem;
+    unsigned int seq;
+    completion_list_array* array;
+    int registered;
+    cpu_set_t cpus;
+    int pinned;
 }completion_list;
 
 
@@ -40,6 +78,12 @@ typedef struct completion_list{
 completion_list* completion_list_create();
 void completion_list_delete(completion_list*);
 void completion_list_add(completion_list*, ums_t, int);
+int completion_list_remove(completion_list*, ums_t);
+int completion_list_copy(completion_list*, unsigned long*, int*, int);
+
+//defined by the library, it tells the kernel module that a registered list changed
+void ums_completion_list_changed(completion_list*, ums_t, int);
+int ums_pin_worker(ums_t, cpu_set_t*);
 
 //debug only
 void completion_list_print(completion_list*);
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "UMSSteal.h"
+
+
+static ums_deque_array* ums_deque_array_create(long capacity){
+    ums_deque_array* array = (ums_deque_array*) malloc(sizeof(ums_deque_array) + capacity * sizeof(ums_t));
+
+    if(!array)
+        return NULL;
+    array->retired = NULL;
+    array->capacity = capacity;
+
+    return array;
+}
+
+/**
+ * @p d the deque \n 
+ * @p old the current array of @p d \n 
+ * @p top the top of @p d \n 
+ * @p bottom the bottom of @p d \n 
+ * 
+ * Replaces the array of @p d with one twice as big; only the owner calls it. The old array is not freed, since a
+ * thief may still be reading it. Returns NULL if the memory could not be allocated.
+ */
+static ums_deque_array* ums_deque_grow(ums_deque* d, ums_deque_array* old, long top, long bottom){
+    ums_deque_array* array = ums_deque_array_create(2 * old->capacity);
+    long i;
+
+    if(!array)
+        return NULL;
+
+    for(i = top; i < bottom; i++)
+        array->ids[i & (array->capacity - 1)] = old->ids[i & (old->capacity - 1)];
+    array->retired = old;
+
+    __atomic_store_n(&d->array, array, __ATOMIC_RELEASE);
+
+    return array;
+}
+
+/**
+ * @p max the maximum number of schedulers (i.e. of completion lists) in the group
+ * 
+ * Creates an empty steal group, that has to be deleted with ums_steal_group_delete() once its schedulers are over.
+ * NULL is returned if the memory could not be allocated.
+ */
+ums_steal_group* ums_steal_group_create(int max){
+    ums_steal_group* g;
+    int i;
+
+    if(max <= 0)
+        return NULL;
+
+    g = (ums_steal_group*) calloc(1, sizeof(ums_steal_group));
+    if(!g)
+        return NULL;
+    pthread_mutex_init(&g->lock, NULL);
+    g->capacity = max;
+
+    g->lists = (struct completion_list**) calloc(max, sizeof(struct completion_list*));
+    //the deques are cacheline aligned, see ums_deque
+    if(posix_memalign((void**) &g->deques, 64, max * sizeof(ums_deque)))
+        g->deques = NULL;
+    if(!g->lists || !g->deques){
+        ums_steal_group_delete(g);
+        return NULL;
+    }
+    memset(g->deques, 0, max * sizeof(ums_deque));
+
+    for(i = 0; i < max; i++){
+        g->deques[i].array = ums_deque_array_create(UMS_DEQUE_MIN_CAPACITY);
+        if(!g->deques[i].array){
+            ums_steal_group_delete(g);
+            return NULL;
+        }
+    }
+
+    return g;
+}
+
+/**
+ * @p g the group to be deleted
+ * 
+ * Deletes the group and frees its memory; the completion lists are not deleted.
+ */
+void ums_steal_group_delete(ums_steal_group* g){
+    ums_deque_array *array, *retired;
+    int i;
+
+    for(i = 0; g->deques && i < g->capacity; i++){
+        array = g->deques[i].array;
+        while(array){
+            retired = array->retired;
+            free(array);
+            array = retired;
+        }
+    }
+
+    pthread_mutex_destroy(&g->lock);
+    free(g->deques);
+    free(g->lists);
+    free(g);
+}
+
+/**
+ * @p g the group \n 
+ * @p cs the completion list of a scheduler \n 
+ * 
+ * Adds the completion list of a scheduler to the group, also while the other schedulers are running. Returns the slot
+ * of the scheduler, to be given to DequeueUmsThreadSteal(), or -1 if the group is full.
+ */
+int ums_steal_group_add(ums_steal_group* g, struct completion_list* cs){
+    int slot;
+
+    pthread_mutex_lock(&g->lock);
+
+    slot = g->len;
+    if(slot == g->capacity){
+        pthread_mutex_unlock(&g->lock);
+        return -1;
+    }
+    g->lists[slot] = cs;
+    //the thieves read len without the lock
+    __atomic_store_n(&g->len, slot + 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&g->lock);
+
+    return slot;
+}
+
+/**
+ * @p g the group
+ * 
+ * Returns the number of threads stolen from the deques of the group so far.
+ */
+unsigned long ums_steal_group_steals(ums_steal_group* g){
+    unsigned long steals = 0;
+    int i, len = __atomic_load_n(&g->len, __ATOMIC_ACQUIRE);
+
+    for(i = 0; i < len; i++)
+        steals += __atomic_load_n(&g->deques[i].steals, __ATOMIC_RELAXED);
+
+    return steals;
+}
+
+/**
+ * @p d the deque of the caller \n 
+ * @p id the thread to be added \n 
+ * 
+ * Adds a thread to the bottom of the deque; only its owner can call it. Returns -1 if the deque was full and it could
+ * not grow.
+ */
+int ums_deque_push(ums_deque* d, ums_t id){
+    long bottom = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+    long top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    ums_deque_array* array = __atomic_load_n(&d->array, __ATOMIC_RELAXED);
+
+    if(bottom - top > array->capacity - 1){
+        array = ums_deque_grow(d, array, top, bottom);
+        if(!array)
+            return -1;
+    }
+
+    __atomic_store_n(&array->ids[bottom & (array->capacity - 1)], id, __ATOMIC_RELAXED);
+    //the thieves that see the new bottom see the thread too
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&d->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+ * @p d the deque of the caller
+ * 
+ * Removes the thread at the bottom of the deque (the last one added); only its owner can call it. Returns 0 if the
+ * deque is empty, or if a thief took its last thread.
+ */
+ums_t ums_deque_take(ums_deque* d){
+    long bottom = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    ums_deque_array* array = __atomic_load_n(&d->array, __ATOMIC_RELAXED);
+    long top;
+    ums_t id = 0;
+
+    __atomic_store_n(&d->bottom, bottom, __ATOMIC_RELAXED);
+    //the thieves either see the new bottom, or the owner sees their new top
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    top = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+    if(top <= bottom){
+        id = __atomic_load_n(&array->ids[bottom & (array->capacity - 1)], __ATOMIC_RELAXED);
+        if(top == bottom){
+            //the last thread, the owner races with the thieves for it
+            if(!__atomic_compare_exchange_n(&d->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                id = 0;
+            __atomic_store_n(&d->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+    }
+    else
+        __atomic_store_n(&d->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+    return id;
+}
+
+/**
+ * @p d the deque of another scheduler
+ * 
+ * Removes the thread at the top of the deque (the oldest one). Returns 0 if the deque is empty, UMS_DEQUE_ABORT if
+ * another thief (or the owner) took the thread in the meantime.
+ */
+ums_t ums_deque_steal(ums_deque* d){
+    long top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    long bottom;
+    ums_deque_array* array;
+    ums_t id;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bottom = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+    if(top >= bottom)
+        return 0;
+
+    array = __atomic_load_n(&d->array, __ATOMIC_ACQUIRE);
+    id = __atomic_load_n(&array->ids[top & (array->capacity - 1)], __ATOMIC_RELAXED);
+    if(!__atomic_compare_exchange_n(&d->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return UMS_DEQUE_ABORT;
+
+    __atomic_add_fetch(&d->steals, 1, __ATOMIC_RELAXED);
+
+    return id;
+}
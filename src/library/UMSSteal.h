@@ -0,0 +1,76 @@
+/**
+ * @file UMSSteal.h
+ * @brief Work stealing between schedulers with private completion lists.
+ *
+ * A ums_steal_group joins the completion lists of some schedulers (one list each); every scheduler of the group has a
+ * Chase-Lev deque in which it keeps the ready threads of its own list. The owner takes them from the bottom of its
+ * deque, without any atomic read-modify-write in the common case, while an idle scheduler steals them from the top
+ * of the deque of a sibling; only the two ends of a deque are shared, and a compare-and-swap is needed only when the
+ * owner and a thief race for the last thread. See DequeueUmsThreadSteal().
+ */
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef pthread_t ums_t;
+
+//see UMSList.h, the group only keeps the pointers
+struct completion_list;
+
+#define UMS_DEQUE_MIN_CAPACITY      16
+
+//returned by ums_deque_steal() when it lost a race with another thief (or with the owner), it can be retried
+#define UMS_DEQUE_ABORT             ((ums_t) -1)
+
+/**
+ * @p retired the previous array of the deque, freed with the deque (a thief may still be reading it) \n 
+ * @p capacity number of slots of @p ids, a power of 2 \n 
+ * @p ids the threads, the slot of index i is ids[i & (capacity - 1)] \n 
+ */
+typedef struct ums_deque_array{
+    struct ums_deque_array* retired;
+    long capacity;
+    ums_t ids[];
+}ums_deque_array;
+
+/**
+ * @p top index of the oldest thread, incremented by the thieves (and by the owner when it takes the last thread) \n 
+ * @p bottom index of the next free slot, only written by the owner \n 
+ * @p array the slots of the deque, replaced by the owner when it is full \n 
+ * @p steals number of threads stolen from this deque \n 
+ *
+ * The two ends are on different cachelines, so that the owner and the thieves do not share a line while the deque is
+ * not almost empty.
+ */
+typedef struct ums_deque{
+    long top __attribute__((aligned(64)));
+    long bottom __attribute__((aligned(64)));
+    ums_deque_array* array;
+    unsigned long steals;
+}ums_deque;
+
+/**
+ * @p len number of completion lists in the group \n 
+ * @p capacity maximum number of completion lists \n 
+ * @p lists the completion lists, one for each scheduler \n 
+ * @p deques the deque of each scheduler \n 
+ * @p lock serializes ums_steal_group_add() \n 
+ */
+typedef struct ums_steal_group{
+    int len;
+    int capacity;
+    struct completion_list** lists;
+    ums_deque* deques;
+    pthread_mutex_t lock;
+}ums_steal_group;
+
+
+ums_steal_group* ums_steal_group_create(int);
+void ums_steal_group_delete(ums_steal_group*);
+int ums_steal_group_add(ums_steal_group*, struct completion_list*);
+unsigned long ums_steal_group_steals(ums_steal_group*);
+
+int ums_deque_push(ums_deque*, ums_t);
+ums_t ums_deque_take(ums_deque*);
+ums_t ums_deque_steal(ums_deque*);
@@ -0,0 +1,759 @@
+#include "UMSLibrary.h"
+
+
+//registry of the workers
+ums_worker* registry[UMS_REGISTRY_MAX_CHUNKS];
+unsigned long registry_used;
+ums_worker* registry_free;
+pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*lock and condition used by the threads that wait for a worker to change its state
+(schedulers in ums_co_dequeue() and joiners in ums_co_join()); co_waiters counts them, so that
+a switch only takes the lock when someone is actually waiting
+*/
+pthread_mutex_t co_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t co_cond = PTHREAD_COND_INITIALIZER;
+int co_waiters;
+
+__thread ums_co_thread co_thread;
+
+
+#if defined(__x86_64__)
+//If this is not added, doxygen parse the assembly in a "strange" way
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+/*
+void ums_co_switch(void** from_sp, void* to_sp)
+saves the callee-saved registers on the current stack, saves the stack pointer in *from_sp
+and restores the registers saved on the stack pointed by to_sp
+*/
+__asm__(
+    ".text\n"
+    ".globl ums_co_switch\n"
+    ".hidden ums_co_switch\n"
+    ".type ums_co_switch, @function\n"
+    "ums_co_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size ums_co_switch, .-ums_co_switch\n"
+);
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+__attribute__((visibility("hidden"))) void ums_co_switch(void**, void*);
+#endif
+
+void ums_co_trampoline(void);
+void* ums_fx_wrapper(void*);
+
+
+/**
+ * @fn ums_co_get_thread
+ *
+ * Returns the scheduler thread the caller is running on. A worker has to call it again after every switch, since it
+ * may have been resumed by another thread: the function is never inlined (and it is not pure), so the compiler
+ * cannot reuse the address of the thread local data computed before the switch.
+ */
+__attribute__((noinline)) ums_co_thread* ums_co_get_thread(void){
+    __asm__ volatile("");
+    return &co_thread;
+}
+
+/**
+ * @p ctx the context to be initialized \n
+ * @p stack the stack of the new coroutine \n
+ * @p size the size of @p stack \n
+ *
+ * Initializes a context that, once resumed, starts executing ums_co_trampoline() on @p stack.
+ */
+void ums_co_make(ums_co_context* ctx, void* stack, size_t size){
+#if defined(__x86_64__)
+    int i;
+    unsigned long* sp = (unsigned long*) (((unsigned long) stack + size) & ~15UL);
+
+    *--sp = 0;                                  //return address of the trampoline, it never returns
+    *--sp = (unsigned long) ums_co_trampoline;  //popped by the ret of ums_co_switch()
+    for(i = 0; i < 6; i++)                      //callee-saved registers
+        *--sp = 0;
+    ctx->sp = sp;
+#else
+    getcontext(ctx);
+    ctx->uc_stack.ss_sp = stack;
+    ctx->uc_stack.ss_size = size;
+    ctx->uc_link = NULL;
+    makecontext(ctx, ums_co_trampoline, 0);
+#endif
+}
+
+/**
+ * @p from where the current context is saved \n
+ * @p to the context to be resumed \n
+ *
+ * Switches from the current coroutine to another one.
+ */
+static inline void ums_co_swap(ums_co_context* from, ums_co_context* to){
+#if defined(__x86_64__)
+    ums_co_switch(&from->sp, to->sp);
+#else
+    swapcontext(from, to);
+#endif
+}
+
+/**
+ * @fn ums_worker_alloc
+ *
+ * Takes a free slot of the registry (a new one if none was freed) and increments its generation; the caller has to
+ * initialize the worker and then publish its id. NULL is returned if the registry is full.
+ */
+ums_worker* ums_worker_alloc(){
+    ums_worker* w;
+    ums_worker* chunk;
+    unsigned long index;
+
+    pthread_mutex_lock(&registry_lock);
+
+    w = registry_free;
+    if(w)
+        registry_free = w->next_free;
+    else{
+        index = registry_used;
+        if((index >> UMS_REGISTRY_CHUNK_BITS) >= UMS_REGISTRY_MAX_CHUNKS){
+            pthread_mutex_unlock(&registry_lock);
+            return NULL;
+        }
+
+        chunk = registry[index >> UMS_REGISTRY_CHUNK_BITS];
+        if(!chunk){
+            chunk = (ums_worker*) calloc(UMS_REGISTRY_CHUNK_SIZE, sizeof(ums_worker));
+            if(!chunk){
+                pthread_mutex_unlock(&registry_lock);
+                return NULL;
+            }
+            //lookups read the chunks without the lock
+            __atomic_store_n(&registry[index >> UMS_REGISTRY_CHUNK_BITS], chunk, __ATOMIC_RELEASE);
+        }
+
+        w = &chunk[index & (UMS_REGISTRY_CHUNK_SIZE - 1)];
+        w->index = index;
+        registry_used++;
+    }
+    w->generation++;
+
+    pthread_mutex_unlock(&registry_lock);
+
+    return w;
+}
+
+/**
+ * @p w the worker to be freed
+ *
+ * Gives back the slot of a worker to the registry; its id will not be found anymore. The stack is kept for the next
+ * worker that will use the slot.
+ */
+void ums_worker_free(ums_worker* w){
+
+    __atomic_store_n(&w->id, 0, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&registry_lock);
+    w->next_free = registry_free;
+    registry_free = w;
+    pthread_mutex_unlock(&registry_lock);
+}
+
+/**
+ * @p id the id of the worker
+ *
+ * Returns the worker with the given id, NULL if it does not exist (or if it was already joined). No lock is taken.
+ */
+ums_worker* ums_worker_find(ums_t id){
+    unsigned long index = id & UMS_REGISTRY_INDEX_MASK;
+    ums_worker* chunk;
+    ums_worker* w;
+
+    if((index >> UMS_REGISTRY_CHUNK_BITS) >= UMS_REGISTRY_MAX_CHUNKS)
+        return NULL;
+
+    chunk = __atomic_load_n(&registry[index >> UMS_REGISTRY_CHUNK_BITS], __ATOMIC_ACQUIRE);
+    if(!chunk)
+        return NULL;
+
+    w = &chunk[index & (UMS_REGISTRY_CHUNK_SIZE - 1)];
+    if(__atomic_load_n(&w->id, __ATOMIC_ACQUIRE) != id)
+        return NULL;
+
+    return w;
+}
+
+/**
+ * @p w the worker whose function returned
+ *
+ * Marks a worker that has a thread of its own (futex backend or worker pool) as done. The state changes under
+ * registry_lock, so that ums_worker_pin() never pins the thread of a worker that is over: the thread may be gone.
+ */
+void ums_worker_done(ums_worker* w){
+
+    pthread_mutex_lock(&registry_lock);
+    __atomic_store_n(&w->state, UMS_CO_DONE, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&registry_lock);
+}
+
+/**
+ * @p id the id of the worker \n
+ * @p cpus the CPUs on which the worker can run \n
+ *
+ * Restricts the thread of a worker of the registry to @p cpus, unless the worker is over (or was joined). Returns 0
+ * on success, an error number otherwise.
+ */
+int ums_worker_pin(ums_t id, cpu_set_t* cpus){
+    ums_worker* w;
+    int ret = ESRCH;
+
+    pthread_mutex_lock(&registry_lock);
+    w = ums_worker_find(id);
+    if(w && __atomic_load_n(&w->state, __ATOMIC_SEQ_CST) != UMS_CO_DONE)
+        ret = pthread_setaffinity_np(w->thread, sizeof(cpu_set_t), cpus);
+    pthread_mutex_unlock(&registry_lock);
+
+    return ret;
+}
+
+/**
+ * @fn ums_co_notify
+ *
+ * Wakes up the threads that are waiting for a worker to change its state, if any.
+ */
+void ums_co_notify(){
+
+    if(__atomic_load_n(&co_waiters, __ATOMIC_SEQ_CST)){
+        pthread_mutex_lock(&co_lock);
+        pthread_cond_broadcast(&co_cond);
+        pthread_mutex_unlock(&co_lock);
+    }
+}
+
+/**
+ * @p t the scheduler thread the caller is running on
+ *
+ * Called right after a switch: the worker that was switched out is now saved, thus it can be marked as idle (or done)
+ * and executed again by any scheduler.
+ */
+void ums_co_release(ums_co_thread* t){
+    ums_worker* w = t->previous;
+
+    if(!w)
+        return;
+    t->previous = NULL;
+
+    __atomic_store_n(&w->state, w->finished ? UMS_CO_DONE : UMS_CO_IDLE, __ATOMIC_SEQ_CST);
+    ums_co_notify();
+}
+
+/**
+ * @fn ums_co_trampoline
+ *
+ * First function executed by every worker, it calls the worker's function and then gives the control back to the
+ * scheduler for the last time.
+ */
+void ums_co_trampoline(){
+    ums_co_thread* t = ums_co_get_thread();
+    ums_worker* w = t->current;
+
+    //we may have been started by ums_co_yield_to()
+    ums_co_release(t);
+
+    w->retval = w->start_routine(w->arg);
+
+    t = ums_co_get_thread();
+    w->finished = 1;
+    t->previous = w;
+    t->current = NULL;
+    ums_co_swap(&w->context, &t->context);
+
+    //a finished worker is never executed again
+    abort();
+}
+
+/**
+ * @p start_routine the function that will execute the worker\n
+ * @p arg the argument of the worker's function\n
+ *
+ * Creates a worker coroutine, ready to be executed. The return value is the ID of the worker, 0 if it could not
+ * be created.
+ */
+ums_t ums_co_create(void *(*start_routine) (void *), void* arg){
+    ums_worker* w = ums_worker_alloc();
+
+    if(!w)
+        return 0;
+
+    if(!w->stack){
+        w->stack = malloc(UMS_COROUTINE_STACK_SIZE);
+        if(!w->stack){
+            ums_worker_free(w);
+            return 0;
+        }
+    }
+
+    w->start_routine = start_routine;
+    w->arg = arg;
+    w->retval = NULL;
+    w->finished = 0;
+    w->state = UMS_CO_IDLE;
+    ums_co_make(&w->context, w->stack, UMS_COROUTINE_STACK_SIZE);
+
+    __atomic_store_n(&w->id, UMS_REGISTRY_ID(w), __ATOMIC_RELEASE);
+
+    return w->id;
+}
+
+/**
+ * @p id the id of the worker that needs to be executed
+ *
+ * Called from a scheduler thread, executes the worker until it yields or ends. Returns 1 if the worker was executed,
+ * 0 if it does not exist or it is not idle (e.g. another scheduler is running it).
+ */
+int ums_co_execute(ums_t id){
+    ums_worker* w = ums_worker_find(id);
+    ums_co_thread* t;
+    int expected = UMS_CO_IDLE;
+
+    if(!w || !__atomic_compare_exchange_n(&w->state, &expected, UMS_CO_RUNNING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return 0;
+
+    t = ums_co_get_thread();
+    t->current = w;
+    ums_co_swap(&t->context, &w->context);
+
+    //the scheduler is always resumed on its own thread
+    ums_co_release(t);
+
+    return 1;
+}
+
+/**
+ * @fn ums_co_yield
+ *
+ * Called from a worker, gives the control back to the scheduler thread that is running it.
+ */
+void ums_co_yield(){
+    ums_co_thread* t = ums_co_get_thread();
+    ums_worker* w = t->current;
+
+    if(!w)
+        return;
+
+    t->previous = w;
+    t->current = NULL;
+    ums_co_swap(&w->context, &t->context);
+
+    //we may have been resumed by another thread, or by ums_co_yield_to()
+    ums_co_release(ums_co_get_thread());
+}
+
+/**
+ * @p id the id of the worker that needs to be executed
+ *
+ * Called from a worker, gives the control directly to the worker @p id on the same scheduler thread. If @p id cannot be
+ * executed this is the same as ums_co_yield().
+ */
+void ums_co_yield_to(ums_t id){
+    ums_co_thread* t = ums_co_get_thread();
+    ums_worker* w = t->current;
+    ums_worker* next = ums_worker_find(id);
+    int expected = UMS_CO_IDLE;
+
+    if(!w)
+        return;
+
+    if(!next || next == w ||
+        !__atomic_compare_exchange_n(&next->state, &expected, UMS_CO_RUNNING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        ums_co_yield();
+        return;
+    }
+
+    t->previous = w;
+    t->current = next;
+    ums_co_swap(&w->context, &next->context);
+
+    ums_co_release(ums_co_get_thread());
+}
+
+/**
+ * @p ids the ids of the completion list \n
+ * @p mem the memory in which the result is saved \n
+ * @p len the length of the completion list \n
+ * @p exist set to 1 if at least one of the workers still exists \n
+ *
+ * Copies @p ids in @p mem, leaving only the ids of the idle workers (the others are set to 0); @p mem may be the same
+ * array of @p ids. Returns the number of idle workers.
+ */
+int ums_co_scan(unsigned long* ids, unsigned long* mem, unsigned long len, int* exist){
+    unsigned long i, id;
+    int found = 0, state;
+    ums_worker* w;
+
+    *exist = 0;
+    for(i = 0; i < len; i++){
+        id = ids[i];
+        w = ums_worker_find(id);
+        state = w ? __atomic_load_n(&w->state, __ATOMIC_SEQ_CST) : UMS_CO_DONE;
+        mem[i] = 0;
+        if(state == UMS_CO_DONE)
+            continue;
+        *exist = 1;
+        if(state == UMS_CO_IDLE){
+            mem[i] = id;
+            found++;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @p ids the ids of the completion list \n
+ * @p mem the memory in which the result is saved \n
+ * @p len the length of the completion list \n
+ * @p flags UMS_DEQUEUE_NONBLOCK to return immediately if no worker is idle \n
+ * @p timeout maximum time to wait (in ms) for a worker to be idle, 0 to wait forever \n
+ *
+ * Same as the dequeue of the kernel module: waits until at least one of the workers is idle and returns how many they
+ * are; 0 is returned if none of them exists, -EAGAIN if none got idle in time.
+ */
+int ums_co_dequeue(unsigned long* ids, unsigned long* mem, unsigned long len, int flags, unsigned long timeout){
+    int found, exist, ret = 0;
+    struct timespec deadline;
+
+    found = ums_co_scan(ids, mem, len, &exist);
+    if(found || !exist)
+        return found;
+    if(flags & UMS_DEQUEUE_NONBLOCK)
+        return -EAGAIN;
+
+    if(timeout){
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000000;
+        if(deadline.tv_nsec >= 1000000000){
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&co_lock);
+    __atomic_add_fetch(&co_waiters, 1, __ATOMIC_SEQ_CST);
+    while(1){
+        found = ums_co_scan(ids, mem, len, &exist);
+        if(found || !exist || ret == ETIMEDOUT)
+            break;
+        if(timeout)
+            ret = pthread_cond_timedwait(&co_cond, &co_lock, &deadline);
+        else
+            pthread_cond_wait(&co_cond, &co_lock);
+    }
+    __atomic_sub_fetch(&co_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&co_lock);
+
+    if(!found && exist)
+        return -EAGAIN;
+
+    return found;
+}
+
+/**
+ * @p ids the ids of the completion list (overwritten) \n
+ * @p prio the priorities of the workers in @p ids \n
+ * @p len the length of the completion list \n
+ * @p policy UMS_POLICY_FIRST_READY or UMS_POLICY_LOWEST_PRIO \n
+ * @p execute the function that executes a worker (ums_co_execute() or ums_fx_execute()) \n
+ *
+ * Same as UMS_DEQUEUE_AND_EXECUTE of the kernel module: waits for an idle worker, picks one according to @p policy
+ * and executes it. Returns the id of the executed worker, 0 if none of them exists anymore.
+ */
+ums_t ums_co_dequeue_execute(unsigned long* ids, int* prio, unsigned long len, int policy, int (*execute) (ums_t)){
+    unsigned long list[len];
+    unsigned long i, best;
+    int found;
+
+    for(i = 0; i < len; i++)
+        list[i] = ids[i];
+
+    while(1){
+        found = ums_co_dequeue(list, ids, len, 0, 0);
+        if(found <= 0)
+            return 0;
+
+        best = len;
+        for(i = 0; i < len; i++){
+            if(!ids[i])
+                continue;
+            if(best == len || (policy == UMS_POLICY_LOWEST_PRIO && prio[i] < prio[best]))
+                best = i;
+            if(policy == UMS_POLICY_FIRST_READY)
+                break;
+        }
+
+        //another scheduler may have taken it in the meantime
+        if(execute(ids[best]))
+            return ids[best];
+    }
+}
+
+/**
+ * @p id the id of the worker \n
+ * @p retval a pointer in which the return value will be saved, if not NULL \n
+ *
+ * Waits for the completion of a worker and frees its slot of the registry. If @p id is not a worker, it is joined as a
+ * thread (e.g. a scheduler); ESRCH is returned for the id of a worker that was already joined.
+ */
+int ums_co_join(ums_t id, void** retval){
+    ums_worker* w = ums_worker_find(id);
+
+    if(!w){
+        //a worker that does not exist anymore (or was already joined) is not a thread
+        if(id & UMS_REGISTRY_ID_TAG)
+            return ESRCH;
+        return pthread_join((pthread_t) id, retval);
+    }
+
+    pthread_mutex_lock(&co_lock);
+    __atomic_add_fetch(&co_waiters, 1, __ATOMIC_SEQ_CST);
+    while(__atomic_load_n(&w->state, __ATOMIC_SEQ_CST) != UMS_CO_DONE)
+        pthread_cond_wait(&co_cond, &co_lock);
+    __atomic_sub_fetch(&co_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&co_lock);
+
+    if(retval)
+        *retval = w->retval;
+    ums_worker_free(w);
+
+    return 0;
+}
+
+/**
+ * @fn ums_co_self
+ *
+ * Returns the id of the worker that is calling, 0 if it is not a worker.
+ */
+ums_t ums_co_self(){
+    ums_co_thread* t = ums_co_get_thread();
+
+    return t->current ? t->current->id : 0;
+}
+
+/**
+ * @p word the futex word \n
+ * @p val the value that @p word must have to go to sleep \n
+ *
+ * Sleeps until @p word is woken up; the caller has to check the value again, since the wake up may be spurious.
+ */
+static inline void ums_futex_wait(int* word, int val){
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+/**
+ * @p word the futex word
+ *
+ * Wakes up the thread that is sleeping on @p word, if any.
+ */
+static inline void ums_futex_wake(int* word){
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/**
+ * @p w the worker to be resumed
+ *
+ * Lets @p w run, @p w must have been claimed by the caller.
+ */
+static inline void ums_fx_run(ums_worker* w){
+    __atomic_store_n(&w->run, 1, __ATOMIC_RELEASE);
+    ums_futex_wake(&w->run);
+}
+
+/**
+ * @p w the calling worker
+ *
+ * Sleeps until the worker is executed again.
+ */
+static inline void ums_fx_park(ums_worker* w){
+    while(!__atomic_load_n(&w->run, __ATOMIC_ACQUIRE))
+        ums_futex_wait(&w->run, 0);
+}
+
+/**
+ * @p t the scheduler thread to be woken up
+ *
+ * Gives the control back to the scheduler thread @p t, that is waiting in ums_fx_execute().
+ */
+static inline void ums_fx_wake_owner(ums_co_thread* t){
+    __atomic_store_n(&t->wake, 1, __ATOMIC_RELEASE);
+    ums_futex_wake(&t->wake);
+}
+
+/**
+ * @p arg the worker
+ *
+ * Function executed by the thread of every worker (futex backend): it waits to be executed for the first time, then
+ * calls the worker's function and gives the control back to the scheduler for the last time.
+ */
+void* ums_fx_wrapper(void* arg){
+    ums_worker* w = (ums_worker*) arg;
+    ums_co_thread* t = ums_co_get_thread();
+
+    //the worker is a thread of its own, thus it is always the current one
+    t->current = w;
+
+    ums_fx_park(w);
+    w->retval = w->start_routine(w->arg);
+
+    t = w->owner;
+    ums_worker_done(w);
+    ums_co_notify();
+    ums_fx_wake_owner(t);
+
+    return w->retval;
+}
+
+/**
+ * @p start_routine the function that will execute the worker\n
+ * @p arg the argument of the worker's function\n
+ *
+ * Creates a worker thread (futex backend), that will wait to be executed. The return value is the ID of the worker,
+ * 0 if it could not be created.
+ */
+ums_t ums_fx_create(void *(*start_routine) (void *), void* arg){
+    ums_worker* w = ums_worker_alloc();
+
+    if(!w)
+        return 0;
+
+    w->start_routine = start_routine;
+    w->arg = arg;
+    w->retval = NULL;
+    w->finished = 0;
+    w->run = 0;
+    w->owner = NULL;
+    w->state = UMS_CO_IDLE;
+
+    if(pthread_create(&w->thread, NULL, ums_fx_wrapper, w)){
+        ums_worker_free(w);
+        return 0;
+    }
+
+    __atomic_store_n(&w->id, UMS_REGISTRY_ID(w), __ATOMIC_RELEASE);
+
+    return w->id;
+}
+
+/**
+ * @p id the id of the worker that needs to be executed
+ *
+ * Called from a scheduler thread, lets the worker run and sleeps until it yields or ends. Returns 1 if the worker was
+ * executed, 0 if it does not exist or it is not idle.
+ */
+int ums_fx_execute(ums_t id){
+    ums_worker* w = ums_worker_find(id);
+    ums_co_thread* t;
+    int expected = UMS_CO_IDLE;
+
+    if(!w || !__atomic_compare_exchange_n(&w->state, &expected, UMS_CO_RUNNING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return 0;
+
+    t = ums_co_get_thread();
+    t->wake = 0;
+    t->switches++;
+    w->owner = t;
+    ums_fx_run(w);
+
+    while(!__atomic_load_n(&t->wake, __ATOMIC_ACQUIRE))
+        ums_futex_wait(&t->wake, 0);
+
+    return 1;
+}
+
+/**
+ * @fn ums_fx_yield
+ *
+ * Called from a worker thread, gives the control back to the scheduler that is running it and sleeps until the worker
+ * is executed again.
+ */
+void ums_fx_yield(){
+    ums_worker* w = ums_co_get_thread()->current;
+    ums_co_thread* t;
+
+    if(!w)
+        return;
+
+    t = w->owner;
+    //the worker has to be idle before its scheduler is resumed, so that the scheduler can execute it again
+    __atomic_store_n(&w->run, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&w->state, UMS_CO_IDLE, __ATOMIC_SEQ_CST);
+    ums_co_notify();
+    ums_fx_wake_owner(t);
+
+    ums_fx_park(w);
+}
+
+/**
+ * @p id the id of the worker that needs to be executed
+ *
+ * Called from a worker thread, gives the control directly to the worker @p id, that will give it back to the scheduler
+ * of the caller. If @p id cannot be executed this is the same as ums_fx_yield().
+ */
+void ums_fx_yield_to(ums_t id){
+    ums_worker* w = ums_co_get_thread()->current;
+    ums_worker* next = ums_worker_find(id);
+    int expected = UMS_CO_IDLE;
+
+    if(!w)
+        return;
+
+    if(!next || next == w ||
+        !__atomic_compare_exchange_n(&next->state, &expected, UMS_CO_RUNNING, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        ums_fx_yield();
+        return;
+    }
+
+    next->owner = w->owner;
+    __atomic_store_n(&w->run, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&w->state, UMS_CO_IDLE, __ATOMIC_SEQ_CST);
+    ums_co_notify();
+    ums_fx_run(next);
+
+    ums_fx_park(w);
+}
+
+/**
+ * @p id the id of the worker \n
+ * @p retval a pointer in which the return value will be saved, if not NULL \n
+ *
+ * Waits for the completion of a worker thread and frees its slot of the registry. If @p id is not a worker, it is
+ * joined as a thread (e.g. a scheduler); ESRCH is returned for the id of a worker that was already joined.
+ */
+int ums_fx_join(ums_t id, void** retval){
+    ums_worker* w = ums_worker_find(id);
+    int ret;
+
+    if(!w){
+        //a worker that does not exist anymore (or was already joined) is not a thread
+        if(id & UMS_REGISTRY_ID_TAG)
+            return ESRCH;
+        return pthread_join((pthread_t) id, retval);
+    }
+
+    ret = pthread_join(w->thread, retval);
+    ums_worker_free(w);
+
+    return ret;
+}
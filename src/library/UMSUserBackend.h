@@ -0,0 +1,135 @@
+/**
+ * @file UMSUserBackend.h
+ * @brief Header for the user-space backends of the library
+ *
+ * Definitions of the backends that switch the workers without going through the kernel module. \n 
+ * With the coroutine backend the workers are stackful coroutines multiplexed on the scheduler threads, thus no kernel
+ * module is involved and a switch is a plain function call. A worker must never block in the kernel (its scheduler
+ * thread would block with it) and must not rely on thread local storage, since it can be resumed by a different
+ * scheduler thread. \n 
+ * With the futex backend the workers are still threads, thus they can block in the kernel, but a scheduler and its
+ * worker hand off the control through a futex word instead of an IOCTL; the kernel module is only used to register the
+ * schedulers (and to account their switches) in the /proc fs. \n 
+ * The backend is selected at build time (make BACKEND=coroutine or make BACKEND=futex) or with the environment
+ * variable UMS_BACKEND (kernel, coroutine or futex).
+ */
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define UMS_BACKEND_KERNEL          0
+#define UMS_BACKEND_COROUTINE       1
+#define UMS_BACKEND_FUTEX           2
+
+#ifndef UMS_DEFAULT_BACKEND
+#define UMS_DEFAULT_BACKEND         UMS_BACKEND_KERNEL
+#endif
+
+#define UMS_COROUTINE_STACK_SIZE    (256 * 1024)
+
+//the registry is made of chunks that are never moved, so that a lookup does not need any lock
+#define UMS_REGISTRY_CHUNK_BITS     10
+#define UMS_REGISTRY_CHUNK_SIZE     (1 << UMS_REGISTRY_CHUNK_BITS)
+#define UMS_REGISTRY_MAX_CHUNKS     1024
+#define UMS_REGISTRY_INDEX_MASK     0xffffffffUL
+//pthread IDs are user space addresses, so the top bit tells the IDs of the registry apart from them
+#define UMS_REGISTRY_ID_TAG         (1UL << 63)
+#define UMS_REGISTRY_ID(w)          (UMS_REGISTRY_ID_TAG | (((w)->generation & 0x7fffffffUL) << 32) | (w)->index)
+
+//states of a worker
+#define UMS_CO_IDLE                 0
+#define UMS_CO_RUNNING              1
+#define UMS_CO_DONE                 2
+
+/**
+ * Saved context of a coroutine; on x86-64 only the stack pointer is needed (the callee-saved registers are pushed
+ * on the stack by ums_co_switch()), elsewhere ucontext is used.
+ */
+#if defined(__x86_64__)
+typedef struct ums_co_context{
+    void* sp;
+}ums_co_context;
+#else
+typedef ucontext_t ums_co_context;
+#endif
+
+/**
+ * @p id the id of the worker, UMS_REGISTRY_ID(); 0 if the slot is free \n
+ * @p index the position of the worker in the registry \n
+ * @p generation incremented each time the slot is reused, so that old ids are not found anymore \n
+ * @p state UMS_CO_IDLE, UMS_CO_RUNNING or UMS_CO_DONE \n
+ * @p finished set by the worker when its function returns \n
+ * @p context the saved context of the worker \n
+ * @p stack the stack of the worker, kept when the slot is reused \n
+ * @p start_routine the function of the worker \n
+ * @p arg the argument of the worker's function \n
+ * @p retval the value returned by the worker's function \n
+ * @p next_free next free slot of the registry \n
+ * @p thread the thread of the worker (futex backend) \n
+ * @p run futex word of the worker, set to 1 to let it run (futex backend) \n
+ * @p owner the scheduler thread that is running the worker, it is woken up when the worker yields (futex backend) \n
+ */
+typedef struct ums_worker{
+    ums_t id;
+    unsigned long index;
+    unsigned long generation;
+    int state;
+    int finished;
+    ums_co_context context;
+    void* stack;
+    void *(*start_routine) (void *);
+    void* arg;
+    void* retval;
+    struct ums_worker* next_free;
+    pthread_t thread;
+    int run;
+    struct ums_co_thread* owner;
+}ums_worker;
+
+/**
+ * @p context the saved context of the scheduler thread \n
+ * @p current the worker that is running on this thread, NULL if the scheduler is running \n
+ * @p previous the worker that has just been switched out, it is released by the code that resumes \n
+ * @p wake futex word of the scheduler, set to 1 by its worker when it yields (futex backend) \n
+ * @p switches number of switches done by the scheduler, not yet accounted to the kernel module (futex backend) \n
+ */
+typedef struct ums_co_thread{
+    ums_co_context context;
+    ums_worker* current;
+    ums_worker* previous;
+    int wake;
+    unsigned long switches;
+}ums_co_thread;
+
+
+//registry
+ums_worker* ums_worker_alloc(void);
+void ums_worker_free(ums_worker*);
+ums_worker* ums_worker_find(ums_t);
+void ums_worker_done(ums_worker*);
+int ums_worker_pin(ums_t, cpu_set_t*);
+
+//coroutine backend
+ums_t ums_co_create(void *(*start_routine) (void *), void*);
+int ums_co_execute(ums_t);
+void ums_co_yield(void);
+void ums_co_yield_to(ums_t);
+int ums_co_dequeue(unsigned long*, unsigned long*, unsigned long, int, unsigned long);
+ums_t ums_co_dequeue_execute(unsigned long*, int*, unsigned long, int, int (*execute) (ums_t));
+int ums_co_join(ums_t, void**);
+ums_t ums_co_self(void);
+ums_co_thread* ums_co_get_thread(void);
+void ums_co_notify(void);
+
+//futex backend
+ums_t ums_fx_create(void *(*start_routine) (void *), void*);
+int ums_fx_execute(ums_t);
+void ums_fx_yield(void);
+void ums_fx_yield_to(ums_t);
+int ums_fx_join(ums_t, void**);
@@ -0,0 +1,110 @@
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "../examples/UMSHeader.h"
+
+#define MAX_SCHED       64
+#define HEAVY_WORKERS   16          //all of them in the list of the first scheduler
+#define NUM_CYCLES      20          //how many times every worker yields
+#define HEAVY_WORK      2000000     //iterations between two yields
+#define LIGHT_WORK      20000
+
+// Global variables:
+struct ums_steal_group* group;
+int steal;
+
+unsigned long now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+// Starting routines:
+void* scheduler(struct completion_list* list, void* arg){
+    int slot = (int) (long) arg;
+    ums_t ready[HEAVY_WORKERS + 1];
+    ums_t next;
+    int n;
+
+    while(1){
+        if(steal)
+            next = DequeueUmsThreadSteal(group, slot);
+        else{
+            n = DequeueUmsCompletionListItemsBuffer(list, ready, NULL, HEAVY_WORKERS + 1, 0, 0);
+            next = n ? ready[0] : 0;
+        }
+        if(!next)
+            break;
+        ExecuteUmsThread(next);
+    }
+
+    return 0;
+}
+
+void* worker(void* arg){
+    long work = (long) arg;
+    volatile unsigned long counter = 0;
+    long i;
+    int j;
+
+    for(j = 0; j < NUM_CYCLES; j++){
+        for(i = 0; i < work; i++)
+            counter++;
+        UmsThreadYield();
+    }
+
+    return 0;
+}
+
+//usage: steal_uneven [schedulers] [private|steal]
+//the first scheduler gets all the heavy workers, every other scheduler a single light one
+int main(int argc, char** argv){
+    struct completion_list* lists[MAX_SCHED];
+    ums_t ids[MAX_SCHED + HEAVY_WORKERS + MAX_SCHED];
+    int num_sched = argc > 1 ? atoi(argv[1]) : 4;
+    int i, n = 0;
+    unsigned long start;
+
+    steal = argc > 2 && !strcmp(argv[2], "steal");
+    if(num_sched < 1 || num_sched > MAX_SCHED){
+        printf("The number of schedulers must be between 1 and %d\n", MAX_SCHED);
+        return -1;
+    }
+
+    group = ums_steal_group_create(num_sched);
+    if(!group){
+        printf("Could not create the steal group\n");
+        return -1;
+    }
+
+    start = now_ns();
+    for(i = 0; i < num_sched; i++){
+        lists[i] = completion_list_create();
+        ums_steal_group_add(group, lists[i]);
+    }
+    for(i = 0; i < HEAVY_WORKERS; i++){
+        ids[n] = EnterUmsWorkingMode(worker, (void*) (long) HEAVY_WORK);
+        completion_list_add(lists[0], ids[n++], 0);
+    }
+    for(i = 1; i < num_sched; i++){
+        ids[n] = EnterUmsWorkingMode(worker, (void*) (long) LIGHT_WORK);
+        completion_list_add(lists[i], ids[n++], 0);
+    }
+    for(i = 0; i < num_sched; i++)
+        ids[n++] = EnterUmsSchedulingMode(lists[i], scheduler, (void*) (long) i);
+
+    for(i = 0; i < n; i++)
+        ums_thread_join(ids[i], 0);
+
+    printf("%d schedulers (%s): %.3f ms, %lu steals\n", num_sched, steal ? "steal" : "private",
+            (now_ns() - start) / 1e6, ums_steal_group_steals(group));
+
+    for(i = 0; i < num_sched; i++)
+        completion_list_delete(lists[i]);
+    ums_steal_group_delete(group);
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "../examples/UMSHeader.h"
+
+#define NUM_ROUNDS      20          //how many times every worker is switched in, per step
+#define MAX_WORKERS     10000
+
+// Global variables:
+int worker_counts[] = {10, 100, 1000, 10000};
+volatile int stop;
+unsigned long switches;
+unsigned long timed_switches;   //switches done while the scheduler was timing, the drain is not counted
+
+unsigned long now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+// Starting routines:
+void* scheduler(struct completion_list* list, void* arg){
+    struct completion_list_item* item;
+    struct completion_list* ready;
+    unsigned long* elapsed = (unsigned long*) arg;
+    unsigned long start;
+    int i;
+
+    //wait for every worker to be parked in the kernel, then let each of them enter its loop
+    do{
+        ready = DequeueUmsCompletionListItems(list);
+        i = ready->len;
+        completion_list_delete(ready);
+    }while(i != list->len);
+
+    for(item = list->head; item; item = item->next)
+        ExecuteUmsThread(item->ums_id);
+
+    switches = 0;
+    start = now_ns();
+    for(i = 0; i < NUM_ROUNDS; i++)
+        for(item = list->head; item; item = item->next)
+            ExecuteUmsThread(item->ums_id);
+    *elapsed = now_ns() - start;
+    timed_switches = switches;
+
+    //let every worker see the stop flag and finish
+    stop = 1;
+    while(1){
+        ready = DequeueUmsCompletionListItems(list);
+        if(ready->len == 0){
+            completion_list_delete(ready);
+            break;
+        }
+        ExecuteUmsThread(ready->head->ums_id);
+        completion_list_delete(ready);
+    }
+
+    return 0;
+}
+
+void* worker(void* arg){
+
+    while(!stop){
+        UmsThreadYield();
+        switches++;         //only one worker at a time is running, no need for atomics
+    }
+
+    return 0;
+}
+
+
+int main() {
+    int i, step, n;
+    unsigned long elapsed;
+    ums_t sched_id;
+    static ums_t id[MAX_WORKERS];
+    struct completion_list* cs;
+    char* backend = getenv("UMS_BACKEND");
+
+    //the backend is chosen by the library (UMS_BACKEND), it is only printed here
+    if(!backend)
+        backend = "default";
+
+    printf("backend,workers,switches,ns_per_switch\n");
+
+    for(step = 0; step < sizeof(worker_counts) / sizeof(worker_counts[0]); step++){
+        n = worker_counts[step];
+        stop = 0;
+
+        cs = completion_list_create();
+        for(i = 0; i < n; i++){
+            id[i] = EnterUmsWorkingMode(worker, 0);
+            completion_list_add(cs, id[i], 0);
+        }
+        sched_id = EnterUmsSchedulingMode(cs, scheduler, &elapsed);
+
+        ums_thread_join(sched_id, 0);
+        for(i = 0; i < n; i++)
+            ums_thread_join(id[i], 0);
+        completion_list_delete(cs);
+
+        //every ExecuteUmsThread + UmsThreadYield pair is two switches
+        printf("%s,%d,%lu,%.1f\n", backend, n, 2 * timed_switches, timed_switches ? (double) elapsed / (2 * timed_switches) : 0.0);
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../examples/UMSHeader.h"
+
+#define SAMPLES         20000       //round trips measured by every scheduler, per configuration
+#define MAX_SCHED       4
+#define MAX_WORKERS     1000        //per scheduler
+
+#define MODE_PRIVATE    0           //every scheduler has its own completion list (example 1)
+#define MODE_SHARED     1           //all the schedulers share the same completion list (example 2)
+
+/**
+ * One of these is given to every worker, the scheduler uses it to check that the worker really ran
+ */
+typedef struct worker_rec{
+    volatile unsigned long runs;
+}worker_rec;
+
+/**
+ * Results of a scheduler: the samples are round trips (ExecuteUmsThread + UmsThreadYield), in ns
+ */
+typedef struct sched_rec{
+    unsigned long samples[SAMPLES];
+    int n;
+    unsigned long start, end;
+}sched_rec;
+
+// Global variables:
+int worker_counts[] = {1, 10, 100, 1000};
+int sched_counts[] = {1, 2, 4};
+char* mode_names[] = {"private", "shared"};
+
+worker_rec recs[MAX_SCHED * MAX_WORKERS];
+sched_rec scheds[MAX_SCHED];
+unsigned long all_samples[MAX_SCHED * SAMPLES];
+volatile int stop;
+int num_sched, finished;
+
+unsigned long now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+int cmp_ul(const void* a, const void* b){
+    unsigned long x = *(const unsigned long*) a, y = *(const unsigned long*) b;
+    return (x > y) - (x < y);
+}
+
+// Starting routines:
+void* scheduler(struct completion_list* list, void* arg){
+    sched_rec* rec = (sched_rec*) arg;
+    ums_t ready[list->len];
+    int prio[list->len];
+    worker_rec* w;
+    unsigned long before, t;
+    int done = 0;
+
+    rec->n = 0;
+    rec->start = now_ns();
+
+    /*once a scheduler has its samples it keeps on executing its workers until every scheduler is done, so that
+    the others are measured under the same load; the prio field of the list is the index of the worker's record
+    */
+    while(!done || __atomic_load_n(&finished, __ATOMIC_SEQ_CST) != num_sched){
+        //the ready threads are saved in the buffers of the scheduler, so that the allocator does not add noise
+        if(DequeueUmsCompletionListItemsBuffer(list, ready, prio, list->len, 0, 0) == 0)
+            break;
+
+        w = &recs[prio[0]];
+        before = w->runs;
+        t = now_ns();
+        ExecuteUmsThread(ready[0]);
+        t = now_ns() - t;
+
+        //the worker may have been taken by another scheduler in the meantime
+        if(done || w->runs == before)
+            continue;
+
+        rec->samples[rec->n++] = t;
+        if(rec->n == SAMPLES){
+            rec->end = now_ns();
+            done = 1;
+            __atomic_add_fetch(&finished, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    //let every worker see the stop flag and finish
+    stop = 1;
+    while(DequeueUmsCompletionListItemsBuffer(list, ready, NULL, list->len, 0, 0) > 0)
+        ExecuteUmsThread(ready[0]);
+
+    return 0;
+}
+
+void* worker(void* arg){
+    worker_rec* rec = (worker_rec*) arg;
+
+    while(!stop){
+        rec->runs++;
+        UmsThreadYield();
+    }
+
+    return 0;
+}
+
+/**
+ * Runs a configuration and prints its results, as a CSV line or as a JSON object
+ */
+void run(int mode, int nsched, int nworkers, int json, int first){
+    static ums_t worker_id[MAX_SCHED * MAX_WORKERS];
+    ums_t sched_id[MAX_SCHED];
+    struct completion_list* cs[MAX_SCHED];
+    unsigned long start = ~0UL, end = 0, n = 0;
+    double per_sec;
+    char* backend = getenv("UMS_BACKEND");
+    int i, j, k;
+
+    //the backend is chosen by the library (UMS_BACKEND), it is only printed here
+    if(!backend)
+        backend = "default";
+
+    stop = 0;
+    finished = 0;
+    num_sched = nsched;
+
+    for(i = 0; i < nsched; i++)
+        cs[i] = (mode == MODE_PRIVATE || i == 0) ? completion_list_create() : cs[0];
+
+    for(i = 0; i < nsched; i++)
+        for(j = 0; j < nworkers; j++){
+            k = i * nworkers + j;
+            recs[k].runs = 0;
+            worker_id[k] = EnterUmsWorkingMode(worker, &recs[k]);
+            completion_list_add(cs[i], worker_id[k], k);
+        }
+
+    for(i = 0; i < nsched; i++)
+        sched_id[i] = EnterUmsSchedulingMode(cs[i], scheduler, &scheds[i]);
+
+    for(i = 0; i < nsched; i++)
+        ums_thread_join(sched_id[i], 0);
+    for(i = 0; i < nsched * nworkers; i++)
+        ums_thread_join(worker_id[i], 0);
+    for(i = 0; i < nsched; i++)
+        if(mode == MODE_PRIVATE || i == 0)
+            completion_list_delete(cs[i]);
+
+    for(i = 0; i < nsched; i++){
+        memcpy(all_samples + n, scheds[i].samples, scheds[i].n * sizeof(unsigned long));
+        n += scheds[i].n;
+        if(scheds[i].start < start)
+            start = scheds[i].start;
+        if(scheds[i].end > end)
+            end = scheds[i].end;
+    }
+    qsort(all_samples, n, sizeof(unsigned long), cmp_ul);
+
+    //every sample is two switches
+    per_sec = (end > start) ? 2.0 * n * 1000000000.0 / (end - start) : 0.0;
+
+    if(json)
+        printf("%s  {\"backend\": \"%s\", \"lists\": \"%s\", \"schedulers\": %d, \"workers\": %d, \"switches\": %lu, "
+                "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f, \"switches_per_sec\": %.0f}",
+                first ? "" : ",\n", backend, mode_names[mode], nsched, nsched * nworkers, 2 * n,
+                all_samples[n / 2] / 2.0, all_samples[n * 99 / 100] / 2.0, all_samples[n * 999 / 1000] / 2.0, per_sec);
+    else
+        printf("%s,%s,%d,%d,%lu,%.1f,%.1f,%.1f,%.0f\n", backend, mode_names[mode], nsched, nsched * nworkers, 2 * n,
+                all_samples[n / 2] / 2.0, all_samples[n * 99 / 100] / 2.0, all_samples[n * 999 / 1000] / 2.0, per_sec);
+    fflush(stdout);
+}
+
+
+int main(int argc, char** argv) {
+    int mode, i, j;
+    int json = argc > 1 && !strcmp(argv[1], "json");
+    int first = 1;
+
+    if(argc > 1 && strcmp(argv[1], "json") && strcmp(argv[1], "csv")){
+        printf("usage: %s [csv|json]\n", argv[0]);
+        return 1;
+    }
+
+    if(json)
+        printf("[\n");
+    else
+        printf("backend,lists,schedulers,workers,switches,p50_ns,p99_ns,p999_ns,switches_per_sec\n");
+
+    for(mode = MODE_PRIVATE; mode <= MODE_SHARED; mode++)
+        for(i = 0; i < sizeof(sched_counts) / sizeof(sched_counts[0]); i++){
+            //a shared list with a single scheduler is the same as a private one
+            if(mode == MODE_SHARED && sched_counts[i] == 1)
+                continue;
+            for(j = 0; j < sizeof(worker_counts) / sizeof(worker_counts[0]); j++){
+                run(mode, sched_counts[i], worker_counts[j], json, first);
+                first = 0;
+            }
+        }
+
+    if(json)
+        printf("\n]\n");
+
+    return 0;
+}
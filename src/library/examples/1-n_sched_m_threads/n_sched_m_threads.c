@@ -17,39 +17,23 @@
 
 // Starting routine:
 void* scheduler(struct completion_list* list, void* arg){
-    struct completion_list_item * item, *next;
-    struct completion_list* ready;
-    int min_prio;
+    struct ums_heap* ready = ums_heap_create();
+    ums_t next;
 
     long unsigned id = (long unsigned) ums_get_id() % 10000;
     printf(SCHED_ID "Scheduler initiated\n",id);
 
         while(1){
-            ready = DequeueUmsCompletionListItems(list);
-
-            if(ready->len == 0){            //in case we exit, we still need to free the list!!!
-                completion_list_delete(ready);
+            //the heap is reused for every decision, the thread with higher priority (lower prio) is on top
+            if(DequeueUmsCompletionListHeap(list, ready, 0, 0) == 0)
                 break;
-            }
-
-            item = ready->head;
-            next = item;
-
-            //compute the thread with higher priority (lower item->prio)
-            min_prio = item->prio;
-            while(item){
-                if(item->prio < min_prio){
-                    min_prio = item->prio;
-                    next = item;
-                }
-                item = item->next;
-            }
-            printf(SCHED_ID "Execute %ld with prio %d\n", id, next->ums_id % 10000, next->prio);
-            ExecuteUmsThread(next->ums_id);
 
-            completion_list_delete(ready);
+            next = ums_heap_pop(ready);
+            printf(SCHED_ID "Execute %ld\n", id, next % 10000);
+            ExecuteUmsThread(next);
 
         }
+    ums_heap_delete(ready);
     printf(SCHED_ID "Scheduler exiting\n",id);
 
     return 0;
@@ -2,6 +2,7 @@
 #include <unistd.h>
 #include "stdlib.h"
 #include <stdio.h>
+#include <time.h>
 #include "../UMSHeader.h"
 
 #define SCHED_ID        "[Sched #%ld]"
@@ -9,7 +10,9 @@
 
 #define NUM_ITERATION   1000000   //one milion
 #define NUM_CYCLES      4        //it is better to pick a divisor of NUM_ITERATION
-#define NUM_SCHED       2
+#ifndef NUM_SCHED
+#define NUM_SCHED       2       //can be changed from the Makefile, see the bench target
+#endif
 #define NUM_WORKER      2
 #define TOTAL_THREADS   NUM_SCHED*(NUM_WORKER + 1)
 
@@ -17,37 +20,29 @@
 
 // Starting routine:
 void* scheduler(struct completion_list* list, void* arg){
-    struct completion_list_item * item, *next;
-    struct completion_list* ready;
-    int min_prio;
+    //the buffers are reused for every decision, nothing is allocated while scheduling; the list is still growing
+    //while the first schedulers start, thus they are sized for all the workers
+    ums_t ready[NUM_SCHED*NUM_WORKER];
+    int prio[NUM_SCHED*NUM_WORKER];
+    int i, n, next;
 
     long unsigned id = (long unsigned) ums_get_id() % 10000;
     printf(SCHED_ID "Scheduler initiated\n",id);
 
         while(1){
-            ready = DequeueUmsCompletionListItems(list);
+            n = DequeueUmsCompletionListItemsBuffer(list, ready, prio, NUM_SCHED*NUM_WORKER, 0, 0);
 
-            if(ready->len == 0){            //in case we exit, we still need to free the list!!!
-                completion_list_delete(ready);
+            if(n == 0)
                 break;
-            }
 
-            item = ready->head;
-            next = item;
-
-            //compute the thread with higher priority (lower item->prio)
-            min_prio = item->prio;
-            while(item){
-                if(item->prio < min_prio){
-                    min_prio = item->prio;
-                    next = item;
-                }
-                item = item->next;
+            //compute the thread with higher priority (lower prio)
+            next = 0;
+            for(i = 1; i < n; i++){
+                if(prio[i] < prio[next])
+                    next = i;
             }
-            printf(SCHED_ID "Execute %ld with prio %d\n", id, next->ums_id % 10000, next->prio);
-            ExecuteUmsThread(next->ums_id);
-
-            completion_list_delete(ready);
+            printf(SCHED_ID "Execute %ld with prio %d\n", id, ready[next] % 10000, prio[next]);
+            ExecuteUmsThread(ready[next]);
 
         }
     printf(SCHED_ID "Scheduler exiting\n",id);
@@ -84,10 +79,12 @@ void* foo1(void* arg){
 int main() {
     int i, j;
     ums_t id[NUM_SCHED*(NUM_WORKER + 1)];
+    struct timespec start, end;
 
-    int vars;
+    int vars = 0;
     struct completion_list* cs = completion_list_create();
 
+    clock_gettime(CLOCK_MONOTONIC, &start);
     for(i=0; i<NUM_SCHED; i++){
 
         for(j=1; j<=NUM_WORKER; j++){
@@ -101,10 +98,15 @@ int main() {
     for(i=0; i<TOTAL_THREADS; i++)
         ums_thread_join(id[i], 0);
 
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
     completion_list_delete(cs);
 
     printf("Main exiting, final value of the counter:\n");
 
     printf("var = %d\n", vars);
 
+    printf("%d schedulers, elapsed time: %.3f ms\n", NUM_SCHED,
+            (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+
 }
\ No newline at end of file
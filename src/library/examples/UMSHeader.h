@@ -10,9 +10,50 @@
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
 #include <pthread.h>
+#include <stdint.h>
 
 typedef pthread_t ums_t;
 
+//flags of DequeueUmsCompletionListItemsEx
+#define UMS_DEQUEUE_NONBLOCK        1
+
+//policies of DequeueAndExecuteUmsThread
+#define UMS_POLICY_FIRST_READY      0
+#define UMS_POLICY_LOWEST_PRIO      1
+
+//modes of ums_set_switch_mode
+#define UMS_SWITCH_WAKEUP           0
+#define UMS_SWITCH_SAME_CPU         1
+
+//layout of /proc/ums/<pid>/stats: a header, then for every scheduler its record followed by the records of its workers
+#define UMS_STATS_MAGIC             0x53534d55
+#define UMS_STATS_VERSION           2
+
+typedef struct ums_stats_header{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_sched;
+    uint32_t num_workers;
+}ums_stats_header;
+
+typedef struct ums_stats_sched{
+    uint64_t id;
+    uint64_t switches;
+    uint64_t total_time;
+    uint64_t last_time;
+    int64_t running;
+    uint64_t steals;
+    uint32_t state;
+    uint32_t worker_num;
+}ums_stats_sched;
+
+typedef struct ums_stats_worker{
+    uint64_t ums_id;
+    uint64_t switches;
+    uint32_t id;
+    uint32_t state;
+}ums_stats_worker;
+
 struct completion_list_item{
     struct completion_list_item* next;
     struct completion_list_item* prev;
@@ -26,22 +67,52 @@ struct completion_list{
     int len;
 };
 
+//opaque, use the ums_heap_* functions
+struct ums_heap;
+
+//opaque, use the ums_steal_group_* functions
+struct ums_steal_group;
+
 
 
 struct completion_list* completion_list_create();
 void completion_list_delete(struct completion_list*);
 void completion_list_add(struct completion_list*, ums_t, int);
+int completion_list_remove(struct completion_list*, ums_t);
+struct ums_heap* ums_heap_create(void);
+void ums_heap_delete(struct ums_heap*);
+int ums_heap_len(struct ums_heap*);
+int ums_heap_push(struct ums_heap*, ums_t, int);
+ums_t ums_heap_top(struct ums_heap*);
+ums_t ums_heap_pop(struct ums_heap*);
+int ums_heap_update(struct ums_heap*, ums_t, int);
+int ums_heap_remove(struct ums_heap*, ums_t);
+struct ums_steal_group* ums_steal_group_create(int);
+void ums_steal_group_delete(struct ums_steal_group*);
+int ums_steal_group_add(struct ums_steal_group*, struct completion_list*);
+unsigned long ums_steal_group_steals(struct ums_steal_group*);
 struct completion_list* DequeueUmsCompletionListItems(struct completion_list*);
+struct completion_list* DequeueUmsCompletionListItemsEx(struct completion_list*, int, unsigned long);
+int DequeueUmsCompletionListItemsBuffer(struct completion_list*, ums_t*, int*, int, int, unsigned long);
+int DequeueUmsCompletionListHeap(struct completion_list*, struct ums_heap*, int, unsigned long);
+int DequeueUmsReadyRingItems(ums_t*, int);
+ums_t DequeueAndExecuteUmsThread(struct completion_list*, int);
+ums_t DequeueUmsThreadSteal(struct ums_steal_group*, int);
 
 //int UMS_init(void);
 //void UMS_exit(void);
 
 //user interface
 ums_t EnterUmsSchedulingMode(void*, void *(*start_routine) (struct completion_list *, void *), void* );
+ums_t EnterUmsSchedulingModeOnCpu(void*, void *(*start_routine) (struct completion_list *, void *), void*, int);
 ums_t EnterUmsWorkingMode(void *(*start_routine) (void *), void* );
+ums_t EnterUmsWorkingModeOnCpu(void *(*start_routine) (void *), void*, int);
 void ExecuteUmsThread(ums_t);
 void UmsThreadYield(void);
+void UmsThreadYieldTo(ums_t);
 int ums_thread_join(ums_t thread, void **retval);
 long unsigned ums_get_id(void);
+int ums_set_worker_pool(int);
+int ums_set_switch_mode(int);
 
 #endif /*DOXYGEN_SHOULD_SKIP_THIS*/
\ No newline at end of file
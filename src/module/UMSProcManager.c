@@ -6,17 +6,36 @@ struct proc_dir_entry *root;
 
 static struct proc_ops pops_sched =
     {
-        .proc_read = myproc_read_sched,
+        .proc_open = myproc_open_sched,
+        .proc_read = seq_read,
+        .proc_lseek = seq_lseek,
+        .proc_release = single_release,
         .proc_write = myproc_write,
 };
 static struct proc_ops pops_work =
     {
-        .proc_read = myproc_read_work,
+        .proc_open = myproc_open_work,
+        .proc_read = seq_read,
+        .proc_lseek = seq_lseek,
+        .proc_release = single_release,
+        .proc_write = myproc_write,
+};
+static struct proc_ops pops_hist =
+    {
+        .proc_open = myproc_open_hist,
+        .proc_read = seq_read,
+        .proc_lseek = seq_lseek,
+        .proc_release = single_release,
+        .proc_write = myproc_write_hist,
+};
+static struct proc_ops pops_stats =
+    {
+        .proc_open = myproc_open_stats,
+        .proc_read = seq_read,
+        .proc_lseek = seq_lseek,
+        .proc_release = single_release,
         .proc_write = myproc_write,
 };
-
-struct list_head* processes;
-rwlock_t* list_lock;
 
 
 ssize_t myproc_write(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos)
@@ -25,12 +44,55 @@ ssize_t myproc_write(struct file *file, const char __user *ubuf, size_t count, l
         return -EINVAL;
 }
 
+/**
+ * @p s the scheduler \n 
+ * @p snap where the statistics are copied \n 
+ * 
+ * Takes a consistent snapshot of the statistics of @p s, retrying if a switch updated them in the meantime.
+ * The seq field of @p snap is not meaningful.
+ */
+void ums_sched_stats_read(sched_item* s, ums_sched_stats* snap)
+{
+        unsigned int seq;
+
+        do{
+                seq = read_seqcount_begin(&s->stats.seq);
+                snap->counter = s->stats.counter;
+                snap->total_time = s->stats.total_time;
+                snap->time = s->stats.time;
+                snap->last_time = s->stats.last_time;
+                snap->state = s->stats.state;
+                snap->running = s->stats.running;
+                snap->yield_time = s->stats.yield_time;
+                memcpy(snap->to_worker, s->stats.to_worker, sizeof(snap->to_worker));
+                memcpy(snap->to_sched, s->stats.to_sched, sizeof(snap->to_sched));
+                snap->steals = s->stats.steals;
+        }while(read_seqcount_retry(&s->stats.seq, seq));
+}
 
 /**
- * @p file the file in which we are trying to read \n 
- * @p ubuf the user buf in which we have to write the answer \n 
- * @p count the length of the read \n 
- * @p ppos the offset \n 
+ * @p s the scheduler of the worker \n 
+ * @p w the worker \n 
+ * @p state where the state of the worker is copied \n 
+ * @p counter where the number of switches of the worker is copied \n 
+ * 
+ * Same as ums_sched_stats_read(), for the statistics of a worker of @p s.
+ */
+void ums_worker_stats_read(sched_item* s, worker_info* w, int* state, int* counter)
+{
+        unsigned int seq;
+
+        do{
+                seq = read_seqcount_begin(&s->stats.seq);
+                *state = w->state;
+                *counter = w->counter;
+        }while(read_seqcount_retry(&s->stats.seq, seq));
+}
+
+
+/**
+ * @p m the seq_file of /proc/ums/<pid>/schedulers/<sched_id>/workers/<worker_id> \n 
+ * @p v unused \n 
  * 
  * This function implements the read functionality for the files in path
  * /proc/ums/<pid>/schedulers/<sched_id>/workers/<worker_id>. The printed values are: \n 
@@ -39,46 +101,20 @@ ssize_t myproc_write(struct file *file, const char __user *ubuf, size_t count, l
  * @p state the state of the scheduler, 0 means that it is running, 1 means that it is not \n 
  * @p  number_of_switches the number of switches
  */
-ssize_t myproc_read_work(struct file *file, char __user *ubuf, size_t count, loff_t *ppos)
+int myproc_show_work(struct seq_file *m, void *v)
 {
-        char buf_path[PATH_MAX_LEN];
-        char* path = dentry_path_raw(file->f_path.dentry, buf_path, PATH_MAX_LEN);
-        long id, worker, pid  = aux_pid_from_path(path);
-        int len = 0, estimated_len;
-        char *buf;
-        worker_info* w;
-        sched_item* s;
-        ums_process *p;
-
-        PROC_FIND_PROCESS_BY_TGID((int) pid, p);
-        id = aux_id_from_path(path);
-        PROC_FIND_SCHED(p, id, s);
-        estimated_len = s->worker_num * MAX_ENTRY_LEN + MAX_STAT_MSG_LEN;
-
-        buf = kmalloc(MAX_WORK_INFO_LEN, GFP_KERNEL);
-        worker = aux_worker_from_path(path);
-        PROC_FIND_WORKER(s, worker, w);
-        if (*ppos > 0 || count < estimated_len){
-                kfree(buf);
-                return 0;
-        }
-        len += sprintf(buf, "worker id: %d\nthread id: %lu\nstate: %d\nnumber of swithces: %d\n", w->id, w->ums_id, w->state, w->counter);
+        worker_info* w = m->private;
+        int state, counter;
 
-        if (copy_to_user(ubuf, buf, len)){
-                kfree(buf);
-                return -EFAULT;
-        }
-        *ppos = len;
-        kfree(buf);
+        ums_worker_stats_read(w->sched, w, &state, &counter);
+        seq_printf(m, "worker id: %d\nthread id: %lu\nstate: %d\nnumber of swithces: %d\n", w->id, w->ums_id, state, counter);
 
-        return len;
+        return 0;
 }
 
 /**
- * @p file the file in which we are trying to read \n 
- * @p ubuf the user buf in which we have to write the answer \n 
- * @p count the length of the read \n 
- * @p ppos the offset \n 
+ * @p m the seq_file of /proc/ums/<pid>/schedulers/<sched_id>/info \n 
+ * @p v unused \n 
  * 
  * This function implements the read functionality for the files in path
  * /proc/ums/<pid>/schedulers/<sched_id>/info. The printed values are: \n 
@@ -88,61 +124,168 @@ ssize_t myproc_read_work(struct file *file, char __user *ubuf, size_t count, lof
  * @p running the id id of the running thread \n 
  * @p last_switch_time how much time (in ns) did it take to do the last switch \n 
  * @p avg_switch_time the average time needed to do the switches \n 
+ * @p steals the number of switches to workers stolen from the list of another scheduler \n 
  * @p completion_list the list of thread with their IDs
  */
-ssize_t myproc_read_sched(struct file *file, char __user *ubuf, size_t count, loff_t *ppos)
+int myproc_show_sched(struct seq_file *m, void *v)
 {
-        char buf_path[PATH_MAX_LEN];
-        char* path = dentry_path_raw(file->f_path.dentry, buf_path, PATH_MAX_LEN);
-        long id, pid  = aux_pid_from_path(path);
-        int len = 0, i, estimated_len;
-        char entry[MAX_ENTRY_LEN], *buf;
+        sched_item* s = m->private;
         worker_info* w;
-        sched_item* s;
-        ums_process *p;
-
-        PROC_FIND_PROCESS_BY_TGID((int) pid, p);
-        id = aux_id_from_path(path);
-        PROC_FIND_SCHED(p, id, s);
-        estimated_len = s->worker_num * MAX_ENTRY_LEN + MAX_STAT_MSG_LEN;
-
-        //printk(KERN_DEBUG MODULE_LOG "Trying to retrieve info of a scheduler");
-        buf = kmalloc(estimated_len, GFP_KERNEL);
-        if (*ppos > 0 || count < estimated_len){
-                kfree(buf);
-                return 0;
-        }
-        len += sprintf(buf, "ID: %ld\nswitches: %lu\nstate: %d\nrunning: %ld\nlast switch time[ns]: %ld\navg switch time[ns]: %ld\n",
-                                                s->id, s->counter, s->state, s->running, s->time, s->total_time/s->counter);
-                                                
-        i = 0;
-        PROC_FIND_WORKER(s, i, w);
-        while(w){
-                i++;
-                len += sprintf(entry, "worker id: %d, ums_id: %ld\n", w->id, w->ums_id);
-                strcat(buf, entry);
-                PROC_FIND_WORKER(s, i, w);
+        ums_sched_stats stats;
+        unsigned long flags;
+        int i;
+
+        ums_sched_stats_read(s, &stats);
+        seq_printf(m, "ID: %ld\nswitches: %lu\nstate: %d\nrunning: %ld\nlast switch time[ns]: %ld\navg switch time[ns]: %ld\n",
+                        s->id, stats.counter, stats.state, stats.running, stats.time,
+                        stats.counter ? stats.total_time/stats.counter : 0);
+        seq_printf(m, "steals: %lu\n", stats.steals);
+
+        //only the list of this scheduler is locked, and only while it is printed
+        read_lock_irqsave(&s->worker_list_lock, flags);
+        for(i = 0; i < s->worker_num; i++){
+                w = s->workers[i];
+                seq_printf(m, "worker id: %d, ums_id: %ld\n", w->id, w->ums_id);
         }
+        read_unlock_irqrestore(&s->worker_list_lock, flags);
 
-        if (copy_to_user(ubuf, buf, len)){
-                kfree(buf);
-                return -EFAULT;
+        return 0;
+}
+
+/**
+ * @p m the seq_file of /proc/ums/<pid>/schedulers/<sched_id>/histogram \n 
+ * @p v unused \n 
+ * 
+ * This function implements the read functionality for the files in path
+ * /proc/ums/<pid>/schedulers/<sched_id>/histogram. Every line is a bucket of the switch latency histograms: \n 
+ * @p latency the lower bound (in ns) of the bucket, the upper one is twice as much \n 
+ * @p to_worker the number of switches from the scheduler to a worker that took that time \n 
+ * @p to_sched the number of switches from a worker back to the scheduler that took that time
+ */
+int myproc_show_hist(struct seq_file *m, void *v)
+{
+        sched_item* s = m->private;
+        ums_sched_stats stats;
+        int i;
+
+        ums_sched_stats_read(s, &stats);
+        seq_puts(m, "latency[ns] to_worker to_sched\n");
+        for(i = 0; i < UMS_HIST_BUCKETS; i++)
+                seq_printf(m, "%lu %lu %lu\n", 1UL << i, stats.to_worker[i], stats.to_sched[i]);
+
+        return 0;
+}
+
+/**
+ * @p m the seq_file of /proc/ums/<pid>/stats \n 
+ * @p v unused \n 
+ * 
+ * This function implements the read functionality for the file /proc/ums/<pid>/stats: the statistics of every
+ * scheduler of the process and of its workers, in the binary layout described by ums_stats_header. The workers of
+ * a scheduler are counted and written under the lock of its list, since they can change at any time (UMS_LIST_ADD);
+ * the header is written first and filled once the records are done, so that its counts match them.
+ */
+int myproc_show_stats(struct seq_file *m, void *v)
+{
+        ums_process* p = m->private;
+        ums_stats_header header;
+        ums_stats_sched rec;
+        ums_stats_worker wrec;
+        ums_sched_stats stats;
+        sched_item* s;
+        worker_info* w;
+        unsigned long flags, flags1;
+        int state, counter, i;
+
+        header.magic = UMS_STATS_MAGIC;
+        header.version = UMS_STATS_VERSION;
+        header.num_sched = 0;
+        header.num_workers = 0;
+        seq_write(m, &header, sizeof(header));
+
+        read_lock_irqsave(&p->sched_list_lock, flags);
+
+        list_for_each_entry_reverse(s, &p->ums_sched_list, list){
+                ums_sched_stats_read(s, &stats);
+                rec.id = s->id;
+                rec.switches = stats.counter;
+                rec.total_time = stats.total_time;
+                rec.last_time = stats.time;
+                rec.running = (long) stats.running;
+                rec.steals = stats.steals;
+                rec.state = stats.state;
+
+                read_lock_irqsave(&s->worker_list_lock, flags1);
+                rec.worker_num = s->worker_num;
+                seq_write(m, &rec, sizeof(rec));
+                header.num_sched++;
+                header.num_workers += rec.worker_num;
+
+                for(i = 0; i < s->worker_num; i++){
+                        w = s->workers[i];
+                        ums_worker_stats_read(s, w, &state, &counter);
+                        wrec.ums_id = w->ums_id;
+                        wrec.switches = counter;
+                        wrec.id = w->id;
+                        wrec.state = state;
+                        seq_write(m, &wrec, sizeof(wrec));
+                }
+                read_unlock_irqrestore(&s->worker_list_lock, flags1);
         }
-        *ppos = len;
-        kfree(buf);
 
-        return len;
+        read_unlock_irqrestore(&p->sched_list_lock, flags);
+
+        //if the buffer overflowed the file is generated again, with a bigger one
+        if(!seq_has_overflowed(m))
+                memcpy(m->buf, &header, sizeof(header));
+
+        return 0;
+}
+
+int myproc_open_stats(struct inode *inode, struct file *file)
+{
+        return single_open(file, myproc_show_stats, PDE_DATA(inode));
+}
+
+int myproc_open_work(struct inode *inode, struct file *file)
+{
+        return single_open(file, myproc_show_work, PDE_DATA(inode));
+}
+
+int myproc_open_sched(struct inode *inode, struct file *file)
+{
+        return single_open(file, myproc_show_sched, PDE_DATA(inode));
+}
+
+int myproc_open_hist(struct inode *inode, struct file *file)
+{
+        return single_open(file, myproc_show_hist, PDE_DATA(inode));
 }
 
 /**
- * @p ums_processes the list of processes that are currently using UMS
+ * @p file the file in which we are trying to write \n 
+ * @p ubuf the user buf with the data \n 
+ * @p count the length of the write \n 
+ * @p ppos the offset \n 
  * 
- * This function initializes the /proc/ums directory.
+ * Any write on /proc/ums/<pid>/schedulers/<sched_id>/histogram resets the histograms of the scheduler. They are
+ * actually cleared at the next switch of the scheduler, since only the task that owns it can write them.
  */
-void ums_create_proc_root(struct list_head* ums_processes, rwlock_t* lock){
+ssize_t myproc_write_hist(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos)
+{
+        sched_item* s = PDE_DATA(file_inode(file));
 
-        processes = ums_processes;
-        list_lock = lock;
+        WRITE_ONCE(s->hist_reset, 1);
+
+        return count;
+}
+
+/**
+ * @fn ums_create_proc_root
+ * 
+ * This function initializes the /proc/ums directory.
+ */
+void ums_create_proc_root(void){
 
         root = proc_mkdir(root_name,NULL);
 
@@ -166,23 +309,25 @@ void ums_delete_proc_root(void){
  */
 void ums_create_proc_process(ums_process* p){
         int tgid = current->tgid;
-        char buf[9];        
+        char buf[MAX_NAME_LEN];
 
         sprintf(buf, "%d", tgid);
         buf[8] = 0;
 
         p->proc_dir = proc_mkdir(buf,root);
         p->sched_dir = proc_mkdir("schedulers",p->proc_dir);
+        proc_create_data("stats", S_IALLUGO, p->proc_dir, &pops_stats, p);
 
 }
 
 /**
  * @p p process that is issuing the request
  * 
- * Deletes the subtree /proc/ums/pid
+ * Deletes the subtree /proc/ums/pid; it waits for the readers that are using it, thus once it returns the items
+ * of the process (bound to the entries as their data) can be freed.
  */
 void ums_delete_proc_process(ums_process* p){
-    
+
         proc_remove(p->proc_dir);
 
 }
@@ -191,106 +336,54 @@ void ums_delete_proc_process(ums_process* p){
  * @p p process that is issuing the request \n 
  * @p s scheduler that is issuing the request \n 
  * 
- * Creates the entries for the scheduler in the /proc fs.
+ * Creates the entries for the scheduler in the /proc fs, with the ones of the workers already in its list; it is
+ * called once the worker list is complete and before the scheduler is published, thus nobody changes the list in the
+ * meantime. The files that read the worker list are created last.
  */
 void ums_create_proc_sched(ums_process* p, sched_item* s){
-        char buf[9];        
+        char buf[MAX_NAME_LEN];
+        int i;
 
         sprintf(buf, "%ld", s->id);
         buf[8] = 0;
 
         s->dir = proc_mkdir(buf, p->sched_dir);
-        s->workers = proc_mkdir("workers", s->dir);   
-        proc_create("info", S_IALLUGO, s->dir, &pops_sched);
+        s->workers_dir = proc_mkdir("workers", s->dir);
+        for(i = 0; i < s->worker_num; i++)
+                ums_create_proc_worker(s, s->workers[i]);
+        proc_create_data("info", S_IALLUGO, s->dir, &pops_sched, s);
+        proc_create_data("histogram", S_IALLUGO, s->dir, &pops_hist, s);
 }
 
 /**
  * @p s scheduler that is issuing the request \n 
- * @p id id of the worker thread that is issuing the request \n 
+ * @p w the worker \n 
  * 
- * Creates the entries for the worker in the /proc fs.
+ * Creates the entries for the worker in the /proc fs. The workers added while the scheduler is introduced get them
+ * from ums_create_proc_sched().
  */
-void ums_create_proc_worker(sched_item* s, int id){
-        char buf[9];        
-        sprintf(buf, "%d", id);
-        buf[8] = 0;
-        proc_create(buf, S_IALLUGO, s->workers, &pops_work);
-
-}
-
-
-//auxiliary methods, used to manage the strings:
+void ums_create_proc_worker(sched_item* s, worker_info* w){
+        char buf[MAX_NAME_LEN];
 
-//return pid (or tgid)
-long aux_pid_from_path(char* path){
-        int i;
-        char buf[MAX_NUM_LEN];
-        long ret;
-        for(i=0; i<MAX_NUM_LEN - 1; i++){
-                if(path[UMS_PREFIX_LEN + i] == '/')
-                        break;
-                buf[i] = path[UMS_PREFIX_LEN + i];
+        if(!s->workers_dir){
+                w->entry = 0;
+                return;
         }
-        buf[i] = 0;
-        kstrtol(buf, 10, &ret);         //base 10
-        return ret;
-}
 
-long aux_id_from_path(char* path){
-        int i, j, counter = 0;
-        char buf[MAX_NUM_LEN];
-        long ret;
-        for(i=0; path[i]; i++){
-                if(path[i] == '/')
-                        counter++;
-                if(counter == NUMBER_OF_SLASHES_BEFORE_ID)
-                        break;
-        }
-        i++;
-        for(j=0; path[i+j]; j++){
-                if(path[i+j] == '/')
-                        break;
-                buf[j] = path[i+j];
-        }
+        sprintf(buf, "%d", w->id);
+        buf[8] = 0;
+        w->entry = proc_create_data(buf, S_IALLUGO, s->workers_dir, &pops_work, w);
 
-        buf[j] = 0;
-        kstrtol(buf, 10, &ret);         //base 10
-        return ret;
 }
 
-long aux_worker_from_path(char* path){
-        int i, j, counter = 0;
-        char buf[32];
-        long ret;
-        for(i=0; path[i]; i++){
-                if(path[i] == '/')
-                        counter++;
-                if(counter == NUMBER_OF_SLASHES_BEFORE_WORKER)
-                        break;
-        }
-        i++;
-        for(j=0; path[i+j]; j++){
-                if(path[i+j] == 0 )
-                        break;
-                buf[j] = path[i+j];
-        }
-
-
-        buf[j] = 0;
-        kstrtol(buf, 10, &ret);         //base 10
+/**
+ * @p w the worker \n 
+ * 
+ * Deletes the entry of the worker in the /proc fs; once it returns nobody is reading it, thus @p w can be reused.
+ */
+void ums_delete_proc_worker(worker_info* w){
 
-        return ret;
-}
+        proc_remove(w->entry);
+        w->entry = 0;
 
-char * strcat(char *dest, const char *src)
-{
-    int i, j;
-    for (i = 0; dest[i] != 0; i++)
-        ;
-
-    for (j = 0; src[j] != 0; j++)
-        dest[j + i] = src[j];
-        
-    dest[j + i] = 0;
-    return dest;
 }
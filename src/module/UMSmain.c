@@ -11,9 +11,17 @@ struct list_head ums_processes;
 //use locks to access the list shared by all processes
 rwlock_t processes_list_lock = __RW_LOCK_UNLOCKED(processes_list_lock);
 
+//slab caches of the items, created by ums_init (they are listed in /proc/slabinfo)
+static struct kmem_cache* thread_item_cache;
+static struct kmem_cache* sched_item_cache;
+static struct kmem_cache* worker_info_cache;
+
 //declaration of the properties of the device file
 static struct file_operations fops = {
-    .unlocked_ioctl = device_ioctl
+    .owner = THIS_MODULE,
+    .unlocked_ioctl = device_ioctl,
+    .mmap = device_mmap,
+    .release = device_release
 };
 
 static struct miscdevice mdev = {
@@ -37,18 +45,23 @@ int __init ums_init(void)
     int ret;
     printk(KERN_INFO MODULE_LOG "Module init.\n");
 
+    ret = ums_create_caches();
+    if(ret < 0)
+        return ret;
+
     ret = misc_register(&mdev);
 
     if (ret < 0)
     {
         printk(KERN_ALERT MODULE_LOG "Registering char device failed\n");
+        ums_destroy_caches();
         return ret;
     }
     printk(KERN_DEBUG MODULE_LOG "Device registered successfully\n");
 
     INIT_LIST_HEAD(&ums_processes);
 
-    ums_create_proc_root(&ums_processes, &processes_list_lock);
+    ums_create_proc_root();
 
     return SUCCESS;
 
@@ -67,9 +80,46 @@ void __exit ums_exit(void)
 
     exit_ums_process_all();
 
+    ums_destroy_caches();
+
     printk(KERN_INFO MODULE_LOG "Module done, exiting\n");
 }
 
+/**
+ * @fn ums_create_caches()
+ * Creates the slab caches of thread_item, sched_item and worker_info: they are allocated and freed every time a
+ * worker or a scheduler is created or destroyed, thus their own caches make it cheaper and show their memory usage
+ * in /proc/slabinfo. The objects are cacheline aligned, so that the items of different threads do not share a line.
+ * Before kernel 6.5 there is no SLAB_NO_MERGE and SLUB may merge the caches with other ones of the same size, thus
+ * they may not appear in /proc/slabinfo: /sys/kernel/slab/ums_* then links to the merged cache (or boot with
+ * slab_nomerge to keep them separate).
+ */
+int ums_create_caches(void){
+
+    thread_item_cache = kmem_cache_create("ums_thread_item", sizeof(thread_item), 0, UMS_CACHE_FLAGS, NULL);
+    sched_item_cache = kmem_cache_create("ums_sched_item", sizeof(sched_item), 0, UMS_CACHE_FLAGS, NULL);
+    worker_info_cache = kmem_cache_create("ums_worker_info", sizeof(worker_info), 0, UMS_CACHE_FLAGS, NULL);
+
+    if(!thread_item_cache || !sched_item_cache || !worker_info_cache){
+        printk(KERN_ALERT MODULE_LOG "Could not create the slab caches\n");
+        ums_destroy_caches();
+        return -ENOMEM;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @fn ums_destroy_caches()
+ * Destroys the slab caches; every item must have been freed already.
+ */
+void ums_destroy_caches(void){
+
+    kmem_cache_destroy(thread_item_cache);
+    kmem_cache_destroy(sched_item_cache);
+    kmem_cache_destroy(worker_info_cache);
+}
+
 /**
  * 
  * @p file the file from which IOCTL was issued \n 
@@ -82,49 +132,104 @@ void __exit ums_exit(void)
 long device_ioctl(struct file *file, unsigned int request, unsigned long data)
 {
     int ret;
+    ums_process *p = file->private_data;
     //printk(KERN_DEBUG MODULE_LOG "Device_ioctl: pid->%d, path=%s, request=%u\n", current->pid, file->f_path.dentry->d_iname, request);
 
-    switch(request){
-        case INIT_UMS_PROCESS:
-            printk(KERN_INFO MODULE_LOG "Process %d is initializing UMS\n", current->pid);
-            init_ums_process(current->pid);
-            ret = SUCCESS;
-            break;
+    if(request == INIT_UMS_PROCESS){
+        printk(KERN_INFO MODULE_LOG "Process %d is initializing UMS\n", current->pid);
+        if(p){
+            printk(KERN_ALERT MODULE_LOG "UMS was already initialized on this file, aborting init_ums_process\n");
+            return UMS_ERROR;
+        }
+        file->private_data = init_ums_process(current->tgid);
+        return file->private_data ? SUCCESS : UMS_ERROR;
+    }
+
+    //every other request works on the process bound to the file by INIT_UMS_PROCESS
+    if(!p || p->tgid != current->tgid){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's process, aborting device_ioctl\n");
+        return UMS_ERROR;
+    }
 
+    switch(request){
         case EXIT_UMS_PROCESS:
             printk(KERN_INFO MODULE_LOG "Process %d is exiting UMS\n", current->pid);
-            exit_ums_process(current->pid);
+            //other threads may still be in a request on p (or sleeping in one), it is freed by device_release()
             ret = SUCCESS;
             break;
 
         case INTRODUCE_UMS_TASK:
             //printk(KERN_INFO MODULE_LOG "New worker thread created\n");
-            ret = new_task_management(data);
+            ret = new_task_management(p, data);
+            break;
+
+        case UMS_ANNOUNCE_TASK:
+            ret = ums_announce_task(p, data);
+            break;
+
+        case UMS_WORKER_PARKING:
+            ret = ums_worker_parking(p);
+            break;
+
+        case UMS_WORKER_PARK:
+            ret = ums_worker_park(p);
+            break;
+
+        case UMS_WORKER_UNPARK:
+            ret = ums_worker_unpark(p, data);
+            break;
+
+        case UMS_SWITCH_MODE:
+            ret = ums_set_switch_mode(p, data);
             break;
 
         case INTRODUCE_UMS_SCHEDULER:
             //printk(KERN_INFO MODULE_LOG "New scheduler created\n");
-            ret = new_scheduler_management(data);
+            ret = new_scheduler_management(p, data);
             break;
 
         case EXECUTE_UMS_THREAD:
             //printk(KERN_INFO MODULE_LOG "Scheduler wants to execute a new thread\n");
-            ret = ums_schedule(data);
+            ret = ums_schedule(p, data);
             break;
 
         case UMS_THREAD_YIELD:
             //printk(KERN_INFO MODULE_LOG "thread %d wants to sleep\n", current->pid);
-            ret = ums_thread_yield();
+            ret = ums_thread_yield(p);
+            break;
+
+        case UMS_DEQUEUE_AND_EXECUTE:
+            ret = ums_dequeue_execute(p, data);
+            break;
+
+        case UMS_THREAD_YIELD_TO:
+            ret = ums_thread_yield_to(p, data);
             break;
 
         case UMS_WORKER_DONE:
             //printk(KERN_INFO MODULE_LOG "thread %d ending\n", current->pid);
-            ret = ums_thread_end();
+            ret = ums_thread_end(p);
             break;
 
         case UMS_DEQUEUE:
             //printk(KERN_INFO MODULE_LOG "Dequeue ums request\n");
-            ret = ums_dequeue_list(data);
+            ret = ums_dequeue_list(p, data, 0, 0);
+            break;
+
+        case UMS_DEQUEUE_EX:
+            ret = ums_dequeue_list_ex(p, data);
+            break;
+
+        case UMS_ACCOUNT_SWITCHES:
+            ret = ums_account_switches(p, data);
+            break;
+
+        case UMS_LIST_ADD:
+            ret = ums_list_change(p, data, 1);
+            break;
+
+        case UMS_LIST_REMOVE:
+            ret = ums_list_change(p, data, 0);
             break;
         
         default:
@@ -136,385 +241,1489 @@ long device_ioctl(struct file *file, unsigned int request, unsigned long data)
 }
 
 /**
- * @fn ums_thread_end
+ * @p inode the inode of the device file \n 
+ * @p file the file that is being released \n 
  * 
- * This function is called when a worker thread ends; it cleans that worker's memory and wakes up its (last) scheduler.
+ * Called when the last reference to an open device file is dropped: the memory of the process bound to the file is
+ * released here, whether it exited UMS or not (e.g. it crashed before the fini_array was run). Every IOCTL holds a
+ * reference to the file while it runs, thus no thread of the process can be in a request (or sleeping in one) on
+ * the process that is freed; EXIT_UMS_PROCESS does not free it for this reason.
  */
-int ums_thread_end(){
-    thread_item *tmp;
-    struct list_head* current_item_list, *q;
-    struct task_struct* sched = 0;
-    unsigned long flags;
-    ums_process *p;
-
-    UMS_FIND_PROCESS_BY_TGID(current->tgid, p);
-
-    if(!p){
-        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's process, aborting ums_thread_end\n");
-        return UMS_ERROR;
-    }
-
-    write_lock_irqsave(&p->thread_list_lock, flags);
-    list_for_each_safe(current_item_list, q, &p->ums_thread_list)
-    {
-        //printk(KERN_INFO MODULE_LOG "Iterating, current = %p, item=%p", current, tmp->task_struct);
-        tmp = list_entry(current_item_list, thread_item, list);
-        if(tmp->task_struct == current){
-            sched = tmp->scheduler;
-            //printk(KERN_INFO MODULE_LOG "Removing current_item=%p, current_item->id=%ld, calling sched: %p\n", tmp, tmp->id, sched);
-            list_del(current_item_list);
-            kfree(tmp);
-            break;
-        }
-    }
-    write_unlock_irqrestore(&p->thread_list_lock, flags);
+int device_release(struct inode *inode, struct file *file)
+{
+    ums_process *p = file->private_data;
 
-    if(!sched){
-        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's scheduler, aborting ums_thread_end\n");
-        return UMS_ERROR;
+    if(p){
+        file->private_data = 0;
+        exit_ums_process(p);
     }
-    
-    while(!wake_up_process(sched)){}
 
     return SUCCESS;
 }
 
 /**
- * @p data containts the pointer to the id of the thread that needs to be scheduled
+ * @p file the device file \n 
+ * @p vma the memory area that is being mapped \n 
  * 
- * This function schedules the next thread to be executed by a scheduler. The scheduling is done by
- * putting the scheduler to sleep in TASK_INTERRUPTIBLE and then by waking up the selected thread. 
+ * Maps the ready ring of the calling scheduler (see ums_ready_ring) in its address space. Once it is mapped, the
+ * kernel publishes in the ring the ids of the workers of the scheduler that get ready to be executed, so that the
+ * scheduler can consume them without issuing an IOCTL. The workers that are already ready are published here.
  */
-int ums_schedule(unsigned long data){
-    unsigned long id, flags;
-    thread_item* next;
+int device_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    ums_process *p = file->private_data;
     sched_item* s;
     worker_info* w;
+    thread_item* t;
+    unsigned long flags;
+    int ret, i;
 
-    //to search the new thread with the macro
-    thread_item* current_item;
-    struct list_head* current_item_list;
-    ums_process *p;
-
-
-    UMS_FIND_PROCESS_BY_TGID(current->tgid, p);
-    if(!p){
-        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's process, aborting ums_schedule\n");
-        return UMS_ERROR;
-    }
-    if(!data){
-        printk(KERN_ALERT MODULE_LOG "NULL pointer found in ums_scheduler request!\n");
-        return UMS_ERROR;
+    if(!p || p->tgid != current->tgid){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's process, aborting device_mmap\n");
+        return -EINVAL;
     }
 
-    copy_from_user(&id, (unsigned long*) data, sizeof(id));
     UMS_FIND_SCHED_ITEM(p, current, s);
-    if(next)
-        FIND_WORKER_BY_UMS_ID(s, next->id, w);
-
-    UMS_LIST_FIND_BY_ID(id, next, p->ums_thread_list);
-
-    spin_lock_irqsave(&p->choice_lock, flags);
-    if(next && next->task_struct->state == TASK_INTERRUPTIBLE){
-
-        //remember who is the scheduler
-        next->scheduler = current;
-        UMS_FIND_SCHED_ITEM(p, current, s);
-        FIND_WORKER_BY_UMS_ID(s, next->id, w);
+    if(!s || vma->vm_pgoff || vma->vm_end - vma->vm_start > PAGE_SIZE){
+        printk(KERN_ALERT MODULE_LOG "Bad mapping request, aborting device_mmap\n");
+        return -EINVAL;
+    }
+    //the page could not be allocated when the scheduler was introduced
+    if(!s->ring)
+        return -ENOMEM;
 
-        if(w){
-            w->state = 1;
-            w->counter = w->counter + 1;
-        }
-        if(s){
-            s->counter++;
-            s->state = 0;
-            s->running = next->id;
-            s->last_time = ktime_get_ns();
-        }
-        while(!wake_up_process(next->task_struct)){}
-        spin_unlock_irqrestore(&p->choice_lock, flags);
+    ret = vm_insert_page(vma, vma->vm_start, virt_to_page(s->ring));
+    if(ret)
+        return ret;
 
-        put_task_to_sleep();
+    //from now on the workers are published as they get ready, a duplicate is harmless while one missing is not
+    smp_store_release(&s->ring_mapped, 1);
 
-        //here the scheduler is executed after the thread yeilded again
-        if(s){
-            s->state = 1;
-            s->running = -1;
-        }
-        if(w)
-            w->state = 0;
+    read_lock_irqsave(&s->worker_list_lock, flags);
+    for(i = 0; i < s->worker_num; i++)
+    {
+        w = s->workers[i];
+        UMS_HASH_FIND_BY_ID(p, w->ums_id, t);
+        if(t && UMS_TASK_IDLE(t))
+            ums_ring_publish(s, t->id);
     }
-    else    //in case we don't run it, we still need to release the lock (otherwise, deadlock incoming)
-        spin_unlock_irqrestore(&p->choice_lock, flags);
-    
+    read_unlock_irqrestore(&s->worker_list_lock, flags);
+
     return SUCCESS;
 }
 
 /**
- * @fn ums_thread_yield
+ * @p s the scheduler that owns the ring \n 
+ * @p id the ums id of the worker that is ready \n 
  * 
- * Called from a worker thread, it gives the control back to its (last) scheduler that will decide the
- * next worker to be run. This is done by putting the thread in TASK_INTERRUPTIBLE state.
+ * Publishes @p id in the ready ring of @p s. If the ring is full the id is dropped and the overflow flag is raised,
+ * the library will then fall back to ums_dequeue_list() to find the ready workers.
  */
+void ums_ring_publish(sched_item* s, unsigned long id){
+    unsigned long head, tail, flags;
+    ums_ready_ring* ring = s->ring;
+
+    spin_lock_irqsave(&s->ring_lock, flags);
+    head = ring->head;
+    //pairs with the release done by the library after it has read the slots
+    tail = smp_load_acquire(&ring->tail);
+    if(head - tail >= UMS_RING_SIZE)
+        WRITE_ONCE(ring->overflow, 1);
+    else{
+        ring->ids[head & (UMS_RING_SIZE - 1)] = id;
+        smp_store_release(&ring->head, head + 1);
+    }
+    spin_unlock_irqrestore(&s->ring_lock, flags);
+}
 
-int ums_thread_yield(){
-    thread_item* current_item;
+/**
+ * @p p the process of the worker \n 
+ * @p t the worker that got ready \n 
+ * 
+ * Publishes a ready worker in the rings of the schedulers that may execute it: its last scheduler or, if it was
+ * never executed, every scheduler that has it in its completion list.
+ */
+void ums_publish_ready(ums_process* p, thread_item* t){
+    sched_item* s;
+    worker_info* w;
     struct list_head* current_item_list;
     unsigned long flags;
-    sched_item* s;
-    struct task_struct* sched;
-    ums_process *p;
 
-    UMS_FIND_PROCESS_BY_TGID(current->tgid, p);
-    if(!p){
-        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's process, aborting ums_thread_yield\n");
-        return UMS_ERROR;
+    if(t->scheduler){
+        UMS_FIND_SCHED_ITEM(p, t->scheduler, s);
+        if(s && smp_load_acquire(&s->ring_mapped))
+            ums_ring_publish(s, t->id);
+        return;
     }
 
-    UMS_LIST_FIND_SCHEDULER(sched, p->ums_thread_list);
+    read_lock_irqsave(&p->sched_list_lock, flags);
+    list_for_each(current_item_list, &p->ums_sched_list)
+    {
+        s = list_entry(current_item_list, sched_item, list);
+        if(!smp_load_acquire(&s->ring_mapped))
+            continue;
+        FIND_WORKER_BY_UMS_ID(s, t->id, w);
+        if(w)
+            ums_ring_publish(s, t->id);
+    }
+    read_unlock_irqrestore(&p->sched_list_lock, flags);
+}
 
-    while(!wake_up_process(sched)){}
+/**
+ * @fn ums_thread_end
+ * 
+ * This function is called when a worker thread ends; it cleans that worker's memory and wakes up its (last) scheduler.
+ */
+int ums_thread_end(ums_process* p){
+    thread_item *tmp;
+    struct task_struct* sched = 0;
+    unsigned long flags;
 
-    put_task_to_sleep();
+    write_lock_irqsave(&p->thread_list_lock, flags);
+    hash_for_each_possible(p->thread_by_task, tmp, task_node, (unsigned long) current)
+    {
+        if(tmp->task_struct == current){
+            sched = tmp->scheduler;
+            //printk(KERN_INFO MODULE_LOG "Removing current_item=%p, current_item->id=%ld, calling sched: %p\n", tmp, tmp->id, sched);
+            hash_del(&tmp->id_node);
+            hash_del(&tmp->task_node);
+            kmem_cache_free(thread_item_cache, tmp);
+            break;
+        }
+    }
+    write_unlock_irqrestore(&p->thread_list_lock, flags);
 
-    //after we are scheduled, we restart from here
-    UMS_FIND_SCHED_ITEM(p, sched, s);
-    //this is less severe, if we don't find the scheduler we just have problems in updating the time
-    if(!s){
-        printk(KERN_WARNING MODULE_LOG "Could not retrieve a thread's scheduler\n");
+    if(!sched){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's scheduler, aborting ums_thread_end\n");
         return UMS_ERROR;
     }
-    s->time = ktime_get_ns() - s->last_time;
-    s->total_time += s->time;
+
+    ums_worker_over(p, sched);
 
     return SUCCESS;
 }
 
-void put_task_to_sleep(){
-
-    //printk(KERN_INFO MODULE_LOG "Putting to sleep %d\n", current->pid);
+/**
+ * @p p the process of the worker \n 
+ * @p sched the (last) scheduler of the worker \n 
+ * 
+ * Called when the function of a worker returned: the control goes back to its scheduler for the last time, and the
+ * schedulers sharing its completion list are told that it is gone.
+ */
+void ums_worker_over(ums_process* p, struct task_struct* sched){
+    sched_item* s;
 
-    set_current_state(TASK_INTERRUPTIBLE);
-    schedule();
+    UMS_FIND_SCHED_ITEM(p, sched, s);
+    if(s){
+        UMS_STATS_WRITE_BEGIN(s);
+        s->stats.yield_time = ktime_get_ns();
+        UMS_STATS_WRITE_END(s);
+    }
+    
+    while(!wake_up_process(sched)){}
 
+    //schedulers sharing the completion list may be waiting to know that this worker is gone
+    ums_wake_schedulers(p);
 }
 
 /**
- * @p data the pointer to the id of the new thread
+ * @p p the process of the calling worker
  * 
- * Called from a worker thread, this function initializes all the data needed to manage a 
- * new worker thread.
+ * Called by a pooled worker thread before it puts itself in the pool of the library, where it can be given a new
+ * worker even before it calls ums_worker_park(): from now on ums_worker_unpark() accepts it.
  */
-
-int new_task_management(unsigned long data){
-    unsigned long pthread_id;
-    ums_process *p;
-    //thread_item* temp;
-    thread_item* item = kmalloc(sizeof(thread_item), GFP_KERNEL);
+int ums_worker_parking(ums_process* p){
+    thread_item* t = 0;
+    thread_item* tmp;
     unsigned long flags;
+    int ret = UMS_ERROR;
 
-    UMS_FIND_PROCESS_BY_TGID(current->tgid, p);
-    if(!p){
-        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's process, aborting new_task_management\n");
-        return UMS_ERROR;
+    write_lock_irqsave(&p->thread_list_lock, flags);
+    hash_for_each_possible(p->thread_by_task, tmp, task_node, (unsigned long) current)
+    {
+        if(tmp->task_struct == current){
+            t = tmp;
+            break;
+        }
     }
-
-    if(!data){
-        printk(KERN_ALERT MODULE_LOG "NULL pointer found in new_task_management request!\n");
-        return UMS_ERROR;
+    if(t && t->pool_state == UMS_POOL_NONE){
+        t->pool_state = UMS_POOL_PARKING;
+        ret = SUCCESS;
     }
-
-    copy_from_user(&pthread_id, (unsigned long*) data, sizeof(pthread_id));
-
-    item = kmalloc(sizeof(thread_item), GFP_KERNEL);
-    item->id = pthread_id;
-    item->task_struct = current;
-    write_lock_irqsave(&p->thread_list_lock, flags);
-    list_add(&item->list, &p->ums_thread_list);
     write_unlock_irqrestore(&p->thread_list_lock, flags);
 
-    //printk(KERN_INFO MODULE_LOG "New worker thread created, ts = %p, pthread_id = %lu\n", current, pthread_id);
-
-    put_task_to_sleep();
-
-    return SUCCESS;
+    if(ret)
+        printk(KERN_ALERT MODULE_LOG "Could not mark the thread as parking, aborting ums_worker_parking\n");
 
+    return ret;
 }
 
-int ums_create_worker_list(sched_item* s, unsigned long ptr){
-    unsigned long len, *mem;
-    unsigned long i, id;
+/**
+ * @p p the process of the calling worker
+ * 
+ * Called by a pooled worker thread when its function returned (see ums_set_worker_pool() in the library): the worker
+ * is over, as with ums_thread_end(), but the thread stays registered and sleeps until ums_worker_unpark() gives it
+ * the id of a new worker. Then it waits to be executed, as a new worker does in new_task_management(), thus neither
+ * the thread nor its thread_item have to be created again. The sleep is not TASK_INTERRUPTIBLE, so that the
+ * schedulers do not consider the thread idle in the meantime (see UMS_TASK_IDLE), but it is killable.
+ */
+int ums_worker_park(ums_process* p){
+    thread_item* t;
+    struct task_struct* sched;
     unsigned long flags;
-    worker_info* w;
 
-    //init the lock
-    s->worker_list_lock = __RW_LOCK_UNLOCKED(s->worker_list_lock);
-    INIT_LIST_HEAD(&s->ums_worker_list);
-
-    copy_from_user(&len, (unsigned long*) ptr, sizeof(len));
-    if(len <= 0){
-        printk(KERN_ALERT MODULE_LOG "Bad len found in completion_list->len\n");
+    UMS_HASH_FIND_BY_TASK(p, current, t);
+    if(!t){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's item, aborting ums_worker_park\n");
         return UMS_ERROR;
     }
 
-    mem = kmalloc(len * sizeof(unsigned long), GFP_KERNEL);
-    copy_from_user(mem, (unsigned long*) (ptr + sizeof(unsigned long)), len * sizeof(unsigned long));
+    write_lock_irqsave(&p->thread_list_lock, flags);
+    //the worker that is over is not found anymore, unless the thread was already given a new one
+    if(t->pool_state != UMS_POOL_UNPARKED){
+        hash_del(&t->id_node);
+        t->pool_state = UMS_POOL_PARKED;
+    }
+    sched = t->scheduler;
+    t->scheduler = 0;
+    write_unlock_irqrestore(&p->thread_list_lock, flags);
 
-    s->worker_num = len;
-    
-    for(i=0; i<len; i++){
-        id = mem[i];
-        w = kmalloc(sizeof(worker_info), GFP_KERNEL);
-        w->id = i;
-        w->ums_id = id;
-        w->state = 0;
-        w->counter = 0;
-        
-        write_lock_irqsave(&s->worker_list_lock, flags);
-        list_add(&w->list, &s->ums_worker_list);
-        write_unlock_irqrestore(&s->worker_list_lock, flags);
-        ums_create_proc_worker(s, i);
-        //printk(KERN_INFO MODULE_LOG "sched %p :Creating worker, id = %d, ums_id=%lu\n", s, w->id, w->ums_id);
+    if(sched)
+        ums_worker_over(p, sched);
+
+    while(1){
+        set_current_state(TASK_KILLABLE);
+        //the thread is going away, its item is removed as ums_thread_end() does
+        if(fatal_signal_pending(current)){
+            __set_current_state(TASK_RUNNING);
+            write_lock_irqsave(&p->thread_list_lock, flags);
+            hash_del(&t->id_node);
+            hash_del(&t->task_node);
+            write_unlock_irqrestore(&p->thread_list_lock, flags);
+            kmem_cache_free(thread_item_cache, t);
+            return UMS_ERROR;
+        }
+        if(READ_ONCE(t->pool_state) == UMS_POOL_UNPARKED)
+            break;
+        schedule();
     }
+    __set_current_state(TASK_RUNNING);
+    WRITE_ONCE(t->pool_state, UMS_POOL_NONE);
 
-    kfree(mem);
+    put_task_to_sleep_notify(p, t);
 
     return SUCCESS;
 }
 
 /**
- * @p ptr the pointer to the id of the new scheduler thread
+ * @p p the process of the caller \n 
+ * @p ptr pointer to a ums_unpark_args struct \n 
  * 
- * Called from a scheduler thread, this function initializes all the data needed to manage a 
- * new scheduler thread. To understand how the list is read, refere to the function ums_dequeue_list() since they use
- * the same mechanism.
+ * Gives a new worker id to a thread parked with ums_worker_park() (or about to park, see ums_worker_parking()) and
+ * wakes it up; from now on the new worker exists, as if it was announced with ums_announce_task(). Any other thread,
+ * e.g. a worker that is running, is rejected.
  */
-int new_scheduler_management(unsigned long ptr){
+int ums_worker_unpark(ums_process* p, unsigned long ptr){
+    ums_unpark_args args;
+    struct task_struct* ts;
+    thread_item* t = 0;
+    thread_item* tmp;
     unsigned long flags;
-    sched_item* item = kmalloc(sizeof(sched_item), GFP_KERNEL);
-    ums_process *p;
 
-    UMS_FIND_PROCESS_BY_TGID(current->tgid, p);
-
-    if(!p){
-        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's process, aborting new_scheduler_management\n");
+    if(!ptr || copy_from_user(&args, (ums_unpark_args*) ptr, sizeof(args))){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in ums_worker_unpark request!\n");
         return UMS_ERROR;
     }
-    if(!ptr){
-        printk(KERN_ALERT MODULE_LOG "NULL pointer found in new_scheduler_management request!\n");
+
+    rcu_read_lock();
+    ts = pid_task(find_vpid(args.tid), PIDTYPE_PID);
+    if(ts)
+        get_task_struct(ts);
+    rcu_read_unlock();
+    if(!ts){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve the parked thread, aborting ums_worker_unpark\n");
         return UMS_ERROR;
     }
 
-    //take the id, we have to use a lock
-    write_lock_irqsave(&p->counter_lock, flags);
-    item->id = p->num_sched;
-    p->num_sched = p->num_sched + 1;
-    write_unlock_irqrestore(&p->counter_lock, flags);
-
-    item->task_struct = current;
-    item->counter = 0;
-    item->time = 0;
-    item->state = 1;
-    item->running = -1;
-    item->worker_num = 0;   //it will change in next functions
-    //create the proc fs entries
-    ums_create_proc_sched(p, item);
-
-    if(ums_create_worker_list(item, ptr))
+    //the item is looked up under the write lock, a parked thread that is killed frees it
+    write_lock_irqsave(&p->thread_list_lock, flags);
+    hash_for_each_possible(p->thread_by_task, tmp, task_node, (unsigned long) ts)
+    {
+        if(tmp->task_struct == ts){
+            t = tmp;
+            break;
+        }
+    }
+    if(!t){
+        write_unlock_irqrestore(&p->thread_list_lock, flags);
+        put_task_struct(ts);
+        printk(KERN_ALERT MODULE_LOG "The thread is not a worker of the process, aborting ums_worker_unpark\n");
         return UMS_ERROR;
+    }
+    if(t->pool_state != UMS_POOL_PARKING && t->pool_state != UMS_POOL_PARKED){
+        write_unlock_irqrestore(&p->thread_list_lock, flags);
+        put_task_struct(ts);
+        printk(KERN_ALERT MODULE_LOG "The thread is not parked, aborting ums_worker_unpark\n");
+        return UMS_ERROR;
+    }
+    //the thread may not have parked yet, in that case its old id is removed here
+    if(!hlist_unhashed(&t->id_node))
+        hash_del(&t->id_node);
+    t->id = args.ums_id;
+    hash_add(p->thread_by_id, &t->id_node, t->id);
+    WRITE_ONCE(t->pool_state, UMS_POOL_UNPARKED);
+    write_unlock_irqrestore(&p->thread_list_lock, flags);
 
-    //create an entry in the scheduler list
-    write_lock_irqsave(&p->sched_list_lock, flags);
-    list_add(&item->list, &p->ums_sched_list);
-    write_unlock_irqrestore(&p->sched_list_lock, flags);
-
-    //printk(KERN_INFO MODULE_LOG "New scheduler, task_struct = %p, id=%ld, item=%p\n", current, item->id, item);
+    wake_up_process(ts);
+    put_task_struct(ts);
 
     return SUCCESS;
 }
 
-
 /**
- * @p ptr pointer to the memory in which the user saved the completion list
+ * @p data containts the pointer to the id of the thread that needs to be scheduled
  * 
- * This function returns the ready threads that can be executed in the completion list
- * of the calling scheduler thread. This is done by reading first the first 8 byte (sizeof(unsigned long))
- * of the memory pointed by @p ptr (passed with IOCTL) to read the length of the list, then a new copy_from_user()
- * is issued to read the list (now we know the dimension). This mechanism was used in order to avoid using 2
- * different IOCTLs (one to read the length, and a second one to read the list). The same mechanism is used in function
- * new_scheduler_management().
+ * This function schedules the next thread to be executed by a scheduler. The scheduling is done by
+ * putting the scheduler to sleep in TASK_INTERRUPTIBLE and then by waking up the selected thread. 
  */
-int ums_dequeue_list(unsigned long ptr){
-    unsigned long len;
-    unsigned long *mem;
+int ums_schedule(ums_process* p, unsigned long data){
     unsigned long id;
-    unsigned long flags;
-    int i, found = 0, exist = 1;
-    struct thread_item* aux;
-    ums_process *p;
-    //to search the new thread with the macro
-    thread_item* current_item;
-    struct list_head* current_item_list;
 
-    UMS_FIND_PROCESS_BY_TGID(current->tgid, p);
-
-    if(!p){
-        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's process, aborting ums_dequeue_list\n");
-        return UMS_ERROR;
+    if(!data){
+        printk(KERN_ALERT MODULE_LOG "NULL pointer found in ums_scheduler request!\n");
+        return UMS_ERROR;
+    }
+
+    copy_from_user(&id, (unsigned long*) data, sizeof(id));
+    ums_execute(p, id);
+
+    return SUCCESS;
+}
+
+/**
+ * @p p the process of the calling scheduler \n 
+ * @p id the id of the thread that needs to be scheduled \n 
+ * 
+ * Core of ums_schedule(), also used by ums_dequeue_execute(). Returns 1 if the thread was executed (and it yielded
+ * back), 0 if it could not be executed because it does not exist or it is not idle.
+ */
+int ums_execute(ums_process* p, unsigned long id){
+    thread_item* next;
+    sched_item* s;
+    worker_info* w;
+    int executed = 0;
+
+    UMS_HASH_FIND_BY_ID(p, id, next);
+
+    if(next && UMS_TASK_CLAIM(next)){
+
+        //remember who is the scheduler
+        next->scheduler = current;
+        UMS_FIND_SCHED_ITEM(p, current, s);
+
+        if(s){
+            FIND_WORKER_BY_UMS_ID(s, next->id, w);
+            UMS_STATS_WRITE_BEGIN(s);
+            if(w){
+                w->state = 1;
+                w->counter = w->counter + 1;
+            }
+            else    //the worker belongs to the list of another scheduler
+                s->stats.steals++;
+            s->stats.counter++;
+            s->stats.state = 0;
+            s->stats.running = next->id;
+            s->stats.last_time = ktime_get_ns();
+            UMS_STATS_WRITE_END(s);
+        }
+        ums_switch_to(p, next);
+
+        //here the scheduler is executed after the thread yeilded again; the thread that yielded is not necessarily
+        //the one we executed, it may have given the control to another worker with ums_thread_yield_to()
+        if(s){
+            FIND_WORKER_BY_UMS_ID(s, s->stats.running, w);
+            UMS_STATS_WRITE_BEGIN(s);
+            if(s->stats.yield_time){
+                UMS_HIST_ADD(s->stats.to_sched, ktime_get_ns() - s->stats.yield_time);
+                s->stats.yield_time = 0;
+            }
+            s->stats.state = 1;
+            s->stats.running = -1;
+            if(w)
+                w->state = 0;
+            UMS_STATS_WRITE_END(s);
+        }
+        executed = 1;
+    }
+    
+    return executed;
+}
+
+/**
+ * @p p the process of the caller \n 
+ * @p mode UMS_SWITCH_WAKEUP or UMS_SWITCH_SAME_CPU \n 
+ * 
+ * Sets how the schedulers of the process give the CPU to their workers, see ums_switch_to().
+ */
+int ums_set_switch_mode(ums_process* p, unsigned long mode){
+
+    if(mode != UMS_SWITCH_WAKEUP && mode != UMS_SWITCH_SAME_CPU){
+        printk(KERN_ALERT MODULE_LOG "Unknown switch mode %lu, aborting ums_set_switch_mode\n", mode);
+        return UMS_ERROR;
+    }
+
+    WRITE_ONCE(p->switch_mode, mode);
+
+    return SUCCESS;
+}
+
+/**
+ * @p p the process of the calling scheduler \n 
+ * @p next the worker claimed by the caller \n 
+ * 
+ * Wakes up @p next and puts the calling scheduler to sleep until it is woken up again. With UMS_SWITCH_WAKEUP the
+ * kernel chooses the CPU of @p next, and it may be another (idle) core than the one of the scheduler. With
+ * UMS_SWITCH_SAME_CPU @p next is woken up on the CPU of the scheduler (unless it is pinned elsewhere, see
+ * ums_move_to_current_cpu()) and the scheduler gives the CPU directly to it with yield_to(), so that @p next is the
+ * task that runs next on this core (with its warm caches) and the scheduler sleeps. The scheduler sets its state to
+ * TASK_INTERRUPTIBLE before it wakes @p next up, thus a worker that yields back before the scheduler leaves the CPU
+ * makes it runnable again and its wake up is not lost.
+ */
+void ums_switch_to(ums_process* p, thread_item* next){
+
+    if(READ_ONCE(p->switch_mode) != UMS_SWITCH_SAME_CPU){
+        ums_restore_cpus(next);
+        while(!wake_up_process(next->task_struct)){}
+        put_task_to_sleep();
+        return;
+    }
+
+    //returns with preemption disabled, so we are still on the CPU of the worker when we wake it up
+    ums_move_to_current_cpu(next);
+    set_current_state(TASK_INTERRUPTIBLE);
+    while(!wake_up_process(next->task_struct)){}
+    put_cpu();
+
+    //yield_to() calls schedule() itself when it handed the CPU over, otherwise (e.g. the worker already yielded back,
+    //or it runs in another scheduling class) we leave the CPU as usual
+    if(yield_to(next->task_struct, true) <= 0)
+        schedule();
+}
+
+/**
+ * @p t a sleeping worker, claimed by the caller \n 
+ * 
+ * Constrains @p t to the CPU of the caller, so that it is woken up there, and returns with preemption disabled (the
+ * caller calls put_cpu() once it woke @p t up), so that the CPU cannot change in between. Nothing is done if @p t is
+ * already constrained to that CPU, which is the common case for a worker that is always executed by the same
+ * scheduler, or if it is pinned (see ums_worker_movable()). Since set_cpus_allowed_ptr() may sleep, the caller may
+ * have been migrated meanwhile: then the worker is moved again.
+ */
+void ums_move_to_current_cpu(thread_item* t){
+    struct task_struct* ts = t->task_struct;
+    int cpu;
+
+    while(1){
+        cpu = get_cpu();
+        if(cpumask_equal(ts->cpus_ptr, cpumask_of(cpu)) || !ums_worker_movable(t))
+            return;
+        put_cpu();
+
+        if(set_cpus_allowed_ptr(ts, cpumask_of(cpu))){
+            get_cpu();
+            return;
+        }
+        t->moved_cpu = cpu;
+    }
+}
+
+/**
+ * @p t a worker claimed by the caller \n 
+ * 
+ * Returns 1 if the CPUs of @p t can be changed by UMS_SWITCH_SAME_CPU: either they are still the ones set by
+ * ums_move_to_current_cpu(), or it was never moved and it has the CPUs of the main thread of its process, i.e. nobody
+ * pinned it (e.g. with EnterUmsWorkingModeOnCpu()). A worker pinned by the user after it was moved is forgotten.
+ */
+int ums_worker_movable(thread_item* t){
+    struct task_struct* ts = t->task_struct;
+
+    if(t->moved_cpu < 0)
+        return cpumask_equal(ts->cpus_ptr, ts->group_leader->cpus_ptr);
+    if(cpumask_equal(ts->cpus_ptr, cpumask_of(t->moved_cpu)))
+        return 1;
+
+    t->moved_cpu = -1;
+    return 0;
+}
+
+/**
+ * @p t a sleeping worker, claimed by the caller \n 
+ * 
+ * Gives back to a worker moved by ums_move_to_current_cpu() the CPUs of the main thread of its process, once it is
+ * executed with UMS_SWITCH_WAKEUP; a worker that was pinned by the user in the meanwhile keeps its CPUs. For a worker
+ * that was never moved this only costs a read.
+ */
+void ums_restore_cpus(thread_item* t){
+    struct task_struct* ts = t->task_struct;
+
+    if(t->moved_cpu < 0)
+        return;
+    if(cpumask_equal(ts->cpus_ptr, cpumask_of(t->moved_cpu)))
+        set_cpus_allowed_ptr(ts, ts->group_leader->cpus_ptr);
+    t->moved_cpu = -1;
+}
+
+/**
+ * @fn ums_thread_yield
+ * 
+ * Called from a worker thread, it gives the control back to its (last) scheduler that will decide the
+ * next worker to be run. This is done by putting the thread in TASK_INTERRUPTIBLE state.
+ */
+
+int ums_thread_yield(ums_process* p){
+    thread_item* t;
+    sched_item* s;
+    struct task_struct* sched;
+
+    UMS_HASH_FIND_BY_TASK(p, current, t);
+    if(!t){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's item, aborting ums_thread_yield\n");
+        return UMS_ERROR;
+    }
+    sched = t->scheduler;
+
+    //the scheduler measures the switch back, see ums_execute()
+    UMS_FIND_SCHED_ITEM(p, sched, s);
+    if(s){
+        UMS_STATS_WRITE_BEGIN(s);
+        s->stats.yield_time = ktime_get_ns();
+        UMS_STATS_WRITE_END(s);
+    }
+
+    while(!wake_up_process(sched)){}
+
+    put_task_to_sleep_notify(p, t);
+
+    //after we are scheduled, we restart from here
+    return ums_update_switch_time(p, t);
+}
+
+/**
+ * @p p the process of the calling worker \n 
+ * @p data containts the pointer to the id of the worker that has to be executed next \n 
+ * 
+ * Called from a worker thread, it gives the control directly to another worker, without waking up the scheduler
+ * in between: the target becomes the running worker of the caller's (last) scheduler, and the counters of the
+ * scheduler and of the workers are updated as ums_schedule() does. If the target cannot be executed (it does not
+ * exist, or it is not idle) this behaves as ums_thread_yield().
+ */
+int ums_thread_yield_to(ums_process* p, unsigned long data){
+    unsigned long id;
+    thread_item *t, *next;
+    sched_item* s = 0;
+    worker_info *w, *nw;
+
+    if(!data || copy_from_user(&id, (unsigned long*) data, sizeof(id))){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in ums_thread_yield_to request!\n");
+        return UMS_ERROR;
+    }
+
+    UMS_HASH_FIND_BY_TASK(p, current, t);
+    if(!t){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve a thread's item, aborting ums_thread_yield_to\n");
+        return UMS_ERROR;
+    }
+    UMS_HASH_FIND_BY_ID(p, id, next);
+    if(!next || next == t)
+        return ums_thread_yield(p);
+
+    UMS_FIND_SCHED_ITEM(p, t->scheduler, s);
+
+    if(!UMS_TASK_CLAIM(next))
+        return ums_thread_yield(p);
+
+    //the target inherits our scheduler, it will give the control back to it
+    next->scheduler = t->scheduler;
+    if(s){
+        FIND_WORKER_BY_UMS_ID(s, t->id, w);
+        FIND_WORKER_BY_UMS_ID(s, next->id, nw);
+        UMS_STATS_WRITE_BEGIN(s);
+        if(w)
+            w->state = 0;
+        if(nw){
+            nw->state = 1;
+            nw->counter = nw->counter + 1;
+        }
+        else
+            s->stats.steals++;
+        s->stats.counter++;
+        s->stats.running = next->id;
+        s->stats.last_time = ktime_get_ns();
+        UMS_STATS_WRITE_END(s);
+    }
+    if(READ_ONCE(p->switch_mode) == UMS_SWITCH_SAME_CPU){
+        //preemption is disabled until the wake up, see ums_move_to_current_cpu()
+        ums_move_to_current_cpu(next);
+        while(!wake_up_process(next->task_struct)){}
+        put_cpu();
+    }
+    else{
+        ums_restore_cpus(next);
+        while(!wake_up_process(next->task_struct)){}
+    }
+
+    put_task_to_sleep_notify(p, t);
+
+    //after we are scheduled, we restart from here
+    return ums_update_switch_time(p, t);
+}
+
+/**
+ * @p p the process of the calling worker \n 
+ * @p t the calling worker \n 
+ * 
+ * Called by a worker right after it was executed again, it updates the switch time of the scheduler that executed it.
+ */
+int ums_update_switch_time(ums_process* p, thread_item* t){
+    sched_item* s;
+
+    UMS_FIND_SCHED_ITEM(p, t->scheduler, s);
+    //this is less severe, if we don't find the scheduler we just have problems in updating the time
+    if(!s){
+        printk(KERN_WARNING MODULE_LOG "Could not retrieve a thread's scheduler\n");
+        return UMS_ERROR;
+    }
+    UMS_STATS_WRITE_BEGIN(s);
+    s->stats.time = ktime_get_ns() - s->stats.last_time;
+    s->stats.total_time += s->stats.time;
+    UMS_HIST_ADD(s->stats.to_worker, s->stats.time);
+    UMS_STATS_WRITE_END(s);
+
+    return SUCCESS;
+}
+
+void put_task_to_sleep(){
+
+    //printk(KERN_INFO MODULE_LOG "Putting to sleep %d\n", current->pid);
+
+    set_current_state(TASK_INTERRUPTIBLE);
+    schedule();
+
+}
+
+/**
+ * @p p the process of the calling worker \n 
+ * @p t the calling worker \n 
+ * 
+ * Same as put_task_to_sleep(), but once the worker is in TASK_INTERRUPTIBLE it is marked as idle (i.e. it can be
+ * executed, see UMS_TASK_CLAIM) and published
+ * in the ready rings and the schedulers that are blocked in ums_dequeue_list() are woken up, so that they can pick it.
+ */
+void put_task_to_sleep_notify(ums_process* p, thread_item* t){
+
+    set_current_state(TASK_INTERRUPTIBLE);
+    //only now a scheduler can claim the worker, its wake up can not get lost (the barrier is in set_current_state)
+    atomic_set(&t->state, UMS_THREAD_IDLE);
+    ums_publish_ready(p, t);
+    ums_wake_schedulers(p);
+    schedule();
+
+    //the scheduler that claimed the worker already did it, this covers a wake up that did not come from a scheduler
+    atomic_set(&t->state, UMS_THREAD_BUSY);
+}
+
+/**
+ * @p p the process whose schedulers have to be woken up
+ * 
+ * Wakes up every scheduler of @p p that is sleeping in ums_dequeue_list(). When no scheduler is waiting (the common
+ * case while the process is busy) this only costs an atomic read.
+ */
+void ums_wake_schedulers(ums_process* p){
+    sched_item* s;
+    struct list_head* current_item_list;
+    unsigned long flags;
+
+    //pairs with the barrier in ums_dequeue_list(), the caller already published its new state
+    smp_mb();
+    if(!atomic_read(&p->dequeue_waiters))
+        return;
+
+    read_lock_irqsave(&p->sched_list_lock, flags);
+    list_for_each(current_item_list, &p->ums_sched_list)
+    {
+        s = list_entry(current_item_list, sched_item, list);
+        wake_up_interruptible(&s->ready_wq);
+    }
+    read_unlock_irqrestore(&p->sched_list_lock, flags);
+}
+
+/**
+ * @p p the process of the caller \n 
+ * @p id the ums id of the thread \n 
+ * 
+ * Returns the item of the thread @p id, creating it (without a task_struct) if it is not registered yet;
+ * NULL if the memory could not be allocated.
+ */
+thread_item* ums_get_thread_item(ums_process* p, unsigned long id){
+    thread_item *item, *tmp;
+    unsigned long flags;
+
+    UMS_HASH_FIND_BY_ID(p, id, item);
+    if(item)
+        return item;
+
+    item = kmem_cache_alloc(thread_item_cache, GFP_KERNEL);
+    if(!item)
+        return 0;
+    item->id = id;
+    item->task_struct = 0;
+    item->scheduler = 0;
+    item->pool_state = UMS_POOL_NONE;
+    item->moved_cpu = -1;
+    atomic_set(&item->state, UMS_THREAD_BUSY);
+    INIT_HLIST_NODE(&item->task_node);
+
+    //look for it again, the announce and the registration of a thread may race
+    write_lock_irqsave(&p->thread_list_lock, flags);
+    hash_for_each_possible(p->thread_by_id, tmp, id_node, id)
+    {
+        if(tmp->id == id){
+            write_unlock_irqrestore(&p->thread_list_lock, flags);
+            kmem_cache_free(thread_item_cache, item);
+            return tmp;
+        }
+    }
+    hash_add(p->thread_by_id, &item->id_node, item->id);
+    write_unlock_irqrestore(&p->thread_list_lock, flags);
+
+    return item;
+}
+
+/**
+ * @p p the process of the caller \n 
+ * @p data the pointer to the id of the new thread \n 
+ * 
+ * Called by the thread that created a worker, right after its creation: the worker exists from now on, thus the
+ * schedulers that have it in their completion list wait for it (it is not idle until it registers with
+ * INTRODUCE_UMS_TASK) instead of considering it over. This way a scheduler can start before its workers registered.
+ */
+int ums_announce_task(ums_process* p, unsigned long data){
+    unsigned long pthread_id;
+
+    if(!data || copy_from_user(&pthread_id, (unsigned long*) data, sizeof(pthread_id))){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in ums_announce_task request!\n");
+        return UMS_ERROR;
+    }
+
+    if(!ums_get_thread_item(p, pthread_id)){
+        printk(KERN_ALERT MODULE_LOG "Could not allocate a thread_item, aborting ums_announce_task\n");
+        return UMS_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @p data the pointer to the id of the new thread
+ * 
+ * Called from a worker thread, this function initializes all the data needed to manage a 
+ * new worker thread; the item created by ums_announce_task() is completed, if there is one.
+ */
+
+int new_task_management(ums_process* p, unsigned long data){
+    unsigned long pthread_id;
+    thread_item* item;
+    unsigned long flags;
+
+    if(!data || copy_from_user(&pthread_id, (unsigned long*) data, sizeof(pthread_id))){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in new_task_management request!\n");
+        return UMS_ERROR;
+    }
+
+    item = ums_get_thread_item(p, pthread_id);
+    if(!item){
+        printk(KERN_ALERT MODULE_LOG "Could not allocate a thread_item, aborting new_task_management\n");
+        return UMS_ERROR;
+    }
+
+    write_lock_irqsave(&p->thread_list_lock, flags);
+    WRITE_ONCE(item->task_struct, current);
+    hash_add(p->thread_by_task, &item->task_node, (unsigned long) item->task_struct);
+    write_unlock_irqrestore(&p->thread_list_lock, flags);
+
+    //printk(KERN_INFO MODULE_LOG "New worker thread created, ts = %p, pthread_id = %lu\n", current, pthread_id);
+
+    put_task_to_sleep_notify(p, item);
+
+    return SUCCESS;
+
+}
+
+/**
+ * @p s the scheduler \n 
+ * @p ptr pointer to the completion list, with the layout described in ums_dequeue_list() \n 
+ * 
+ * Creates the worker list of a new scheduler from its completion list. The list can be empty, the threads can be
+ * added later with UMS_LIST_ADD.
+ */
+int ums_create_worker_list(sched_item* s, unsigned long ptr){
+    unsigned long len, *mem;
+    unsigned long i;
+
+    //init the lock
+    s->worker_list_lock = __RW_LOCK_UNLOCKED(s->worker_list_lock);
+    s->workers = 0;
+    s->workers_cap = 0;
+    hash_init(s->worker_by_id);
+    INIT_LIST_HEAD(&s->free_workers);
+    s->worker_num = 0;
+    s->next_worker_id = 0;
+
+    if(copy_from_user(&len, (unsigned long*) ptr, sizeof(len))){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in completion_list->len\n");
+        return UMS_ERROR;
+    }
+    if(!len)
+        return SUCCESS;
+    if(len > UMS_MAX_LIST_LEN){
+        printk(KERN_ALERT MODULE_LOG "Completion list too long, aborting ums_create_worker_list\n");
+        return UMS_ERROR;
+    }
+
+    mem = kmalloc_array(len, sizeof(unsigned long), GFP_KERNEL);
+    if(!mem || copy_from_user(mem, (unsigned long*) (ptr + sizeof(unsigned long)), len * sizeof(unsigned long))){
+        printk(KERN_ALERT MODULE_LOG "Bad len found in completion_list->len\n");
+        kfree(mem);
+        return UMS_ERROR;
+    }
+
+    for(i=0; i<len; i++){
+        if(ums_add_worker(s, mem[i])){
+            kfree(mem);
+            return UMS_ERROR;
+        }
+    }
+
+    kfree(mem);
+
+    return SUCCESS;
+}
+
+/**
+ * @p s the scheduler
+ * 
+ * Makes sure that the worker array of @p s has a free slot, doubling it if it is full; the new array is allocated out
+ * of the lock, since the allocation may sleep.
+ */
+int ums_reserve_worker_slot(sched_item* s){
+    worker_info **workers, **old = 0;
+    unsigned long flags;
+    int cap, full;
+
+    read_lock_irqsave(&s->worker_list_lock, flags);
+    full = s->worker_num == s->workers_cap;
+    cap = s->workers_cap;
+    read_unlock_irqrestore(&s->worker_list_lock, flags);
+    if(!full)
+        return SUCCESS;
+
+    cap = cap ? 2 * cap : UMS_WORKER_MIN_SLOTS;
+    workers = kmalloc_array_node(cap, sizeof(worker_info*), GFP_KERNEL, s->node);
+    if(!workers)
+        return UMS_ERROR;
+
+    write_lock_irqsave(&s->worker_list_lock, flags);
+    if(cap > s->workers_cap){
+        if(s->worker_num)
+            memcpy(workers, s->workers, s->worker_num * sizeof(worker_info*));
+        old = s->workers;
+        s->workers = workers;
+        s->workers_cap = cap;
+        workers = 0;
+    }
+    write_unlock_irqrestore(&s->worker_list_lock, flags);
+
+    kfree(old);
+    kfree(workers);
+
+    return SUCCESS;
+}
+
+/**
+ * @p s the scheduler \n 
+ * @p id the ums id of the thread \n 
+ * 
+ * Adds a thread to the worker list of @p s (nothing is done if it is already there) and creates its /proc entry.
+ * A worker_info released by ums_remove_worker() is reused, if there is one.
+ */
+int ums_add_worker(sched_item* s, unsigned long id){
+    unsigned long flags;
+    worker_info* w;
+
+    FIND_WORKER_BY_UMS_ID(s, id, w);
+    if(w)
+        return SUCCESS;
+
+    if(ums_reserve_worker_slot(s)){
+        printk(KERN_ALERT MODULE_LOG "Could not grow the worker array, aborting ums_add_worker\n");
+        return UMS_ERROR;
     }
-    if(!ptr){
-        printk(KERN_ALERT MODULE_LOG "NULL pointer found in ums_dequeue_list request!\n");
+
+    write_lock_irqsave(&s->worker_list_lock, flags);
+    w = list_first_entry_or_null(&s->free_workers, worker_info, list);
+    if(w)
+        list_del(&w->list);
+    write_unlock_irqrestore(&s->worker_list_lock, flags);
+
+    if(!w)
+        w = kmem_cache_alloc_node(worker_info_cache, GFP_KERNEL, s->node);
+    if(!w){
+        printk(KERN_ALERT MODULE_LOG "Could not allocate a worker_info, aborting ums_add_worker\n");
+        return UMS_ERROR;
+    }
+
+    w->ums_id = id;
+    w->state = 0;
+    w->counter = 0;
+    w->sched = s;
+
+    write_lock_irqsave(&s->worker_list_lock, flags);
+    //the array may have been filled by a concurrent add in the meantime
+    while(s->worker_num == s->workers_cap){
+        write_unlock_irqrestore(&s->worker_list_lock, flags);
+        if(ums_reserve_worker_slot(s)){
+            write_lock_irqsave(&s->worker_list_lock, flags);
+            list_add(&w->list, &s->free_workers);
+            write_unlock_irqrestore(&s->worker_list_lock, flags);
+            printk(KERN_ALERT MODULE_LOG "Could not grow the worker array, aborting ums_add_worker\n");
+            return UMS_ERROR;
+        }
+        write_lock_irqsave(&s->worker_list_lock, flags);
+    }
+    w->id = s->next_worker_id++;
+    w->slot = s->worker_num++;
+    s->workers[w->slot] = w;
+    hash_add(s->worker_by_id, &w->node, w->ums_id);
+    write_unlock_irqrestore(&s->worker_list_lock, flags);
+    ums_create_proc_worker(s, w);
+    //printk(KERN_INFO MODULE_LOG "sched %p :Creating worker, id = %d, ums_id=%lu\n", s, w->id, w->ums_id);
+
+    return SUCCESS;
+}
+
+/**
+ * @p s the scheduler \n 
+ * @p id the ums id of the thread \n 
+ * 
+ * Removes a thread from the worker list of @p s and deletes its /proc entry; its worker_info is moved to the
+ * free_workers list (see worker_info). Nothing is done if the thread is not in the list.
+ */
+int ums_remove_worker(sched_item* s, unsigned long id){
+    unsigned long flags;
+    worker_info *w = 0, *tmp;
+
+    write_lock_irqsave(&s->worker_list_lock, flags);
+    hash_for_each_possible(s->worker_by_id, tmp, node, id){
+        if(tmp->ums_id == id){
+            w = tmp;
+            hash_del(&w->node);
+            //the last worker of the array takes its slot
+            s->worker_num--;
+            s->workers[w->slot] = s->workers[s->worker_num];
+            s->workers[w->slot]->slot = w->slot;
+            s->workers[s->worker_num] = 0;
+            break;
+        }
+    }
+    write_unlock_irqrestore(&s->worker_list_lock, flags);
+
+    if(!w)
+        return SUCCESS;
+
+    ums_delete_proc_worker(w);
+
+    write_lock_irqsave(&s->worker_list_lock, flags);
+    list_add(&w->list, &s->free_workers);
+    write_unlock_irqrestore(&s->worker_list_lock, flags);
+
+    return SUCCESS;
+}
+
+/**
+ * @p p the process of the caller \n 
+ * @p ptr pointer to a ums_list_args struct \n 
+ * @p add 1 if the thread was added to the list, 0 if it was removed \n 
+ * 
+ * Called by the library when a thread is added to (or removed from) a completion list after a scheduler was
+ * introduced with it: the worker lists of every scheduler of that list are updated. The library serializes this
+ * request with the introduction of the schedulers of the list, thus none of them is missed.
+ */
+int ums_list_change(ums_process* p, unsigned long ptr, int add){
+    ums_list_args args;
+    sched_item **scheds, *s;
+    unsigned long flags;
+    int i, n, num;
+
+    if(!ptr || copy_from_user(&args, (ums_list_args*) ptr, sizeof(args))){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in ums_list_change request!\n");
         return UMS_ERROR;
     }
 
-    copy_from_user(&len, (unsigned long*) ptr, sizeof(len));
-    if(len <= 0){
-        printk(KERN_ALERT MODULE_LOG "Bad len found in completion_list->len, aborting ums_dequeue_list\n");
+    read_lock_irqsave(&p->counter_lock, flags);
+    num = p->num_sched;
+    read_unlock_irqrestore(&p->counter_lock, flags);
+    if(!num)
+        return SUCCESS;
+
+    //the worker lists can not be changed while the scheduler list is locked (creating the /proc entries may sleep),
+    //so the schedulers are collected first; they are only freed when the process exits UMS
+    scheds = kmalloc_array(num, sizeof(sched_item*), GFP_KERNEL);
+    if(!scheds){
+        printk(KERN_ALERT MODULE_LOG "Could not allocate memory, aborting ums_list_change\n");
         return UMS_ERROR;
     }
-    mem = kmalloc(len * sizeof(unsigned long), GFP_KERNEL);
-    copy_from_user(mem, (unsigned long*) (ptr + sizeof(unsigned long)), len * sizeof(unsigned long));
 
-    //printk(KERN_INFO MODULE_LOG "number of items = %lu, 1st=%lu 2nd=%lu\n", len, mem[0], mem[1]);
+    n = 0;
+    read_lock_irqsave(&p->sched_list_lock, flags);
+    list_for_each_entry(s, &p->ums_sched_list, list){
+        if(s->list_key == args.key && n < num)
+            scheds[n++] = s;
+    }
+    read_unlock_irqrestore(&p->sched_list_lock, flags);
 
-    //if no thread is ready, iterate
-    while(!found && exist){
-        found = 0;
-        exist = 0;
-        for(i=0; i<len; i++){
-            id = mem[i];
-            UMS_LIST_FIND_BY_ID(id, aux, p->ums_thread_list);
-            if(!aux)                //the item does not exist yet, or it has exited alreay
+    for(i = 0; i < n; i++){
+        if(add ? ums_add_worker(scheds[i], args.ums_id) : ums_remove_worker(scheds[i], args.ums_id)){
+            kfree(scheds);
+            return UMS_ERROR;
+        }
+    }
+
+    kfree(scheds);
+
+    return SUCCESS;
+}
+
+/**
+ * @p ptr pointer to a ums_introduce_args struct
+ * 
+ * Called from a scheduler thread, this function initializes all the data needed to manage a 
+ * new scheduler thread. To understand how the list is read, refere to the function ums_dequeue_list() since they use
+ * the same mechanism.
+ */
+int new_scheduler_management(ums_process* p, unsigned long ptr){
+    unsigned long flags;
+    ums_introduce_args args;
+    sched_item* item;
+    struct page* ring;
+    int node = numa_node_id();
+
+    if(!ptr || copy_from_user(&args, (ums_introduce_args*) ptr, sizeof(args)) || !args.list){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in new_scheduler_management request!\n");
+        return UMS_ERROR;
+    }
+
+    //the data of the scheduler goes on its NUMA node (a scheduler pinned by the library already runs on its CPU)
+    item = kmem_cache_alloc_node(sched_item_cache, GFP_KERNEL, node);
+    if(!item){
+        printk(KERN_ALERT MODULE_LOG "Could not allocate a sched_item, aborting new_scheduler_management\n");
+        return UMS_ERROR;
+    }
+
+    //take the id, we have to use a lock
+    write_lock_irqsave(&p->counter_lock, flags);
+    item->id = p->num_sched;
+    p->num_sched = p->num_sched + 1;
+    write_unlock_irqrestore(&p->counter_lock, flags);
+
+    item->task_struct = current;
+    item->list_key = args.key;
+    seqcount_init(&item->stats.seq);
+    item->stats.counter = 0;
+    item->stats.total_time = 0;
+    item->stats.time = 0;
+    item->stats.last_time = 0;
+    item->stats.state = 1;
+    item->stats.running = -1;
+    item->stats.yield_time = 0;
+    item->stats.steals = 0;
+    memset(item->stats.to_worker, 0, sizeof(item->stats.to_worker));
+    memset(item->stats.to_sched, 0, sizeof(item->stats.to_sched));
+    item->hist_reset = 0;
+    init_waitqueue_head(&item->ready_wq);
+    item->node = node;
+    ring = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO, 0);
+    item->ring = ring ? (ums_ready_ring*) page_address(ring) : 0;
+    spin_lock_init(&item->ring_lock);
+    item->ring_mapped = 0;
+    item->dir = 0;
+    item->workers_dir = 0;
+
+    if(ums_create_worker_list(item, args.list)){
+        ums_free_sched_item(item);
+        return UMS_ERROR;
+    }
+
+    //the proc fs entries read the worker list, thus they are created once it is complete
+    ums_create_proc_sched(p, item);
+
+    //create an entry in the scheduler list
+    write_lock_irqsave(&p->sched_list_lock, flags);
+    list_add(&item->list, &p->ums_sched_list);
+    write_unlock_irqrestore(&p->sched_list_lock, flags);
+
+    //printk(KERN_INFO MODULE_LOG "New scheduler, task_struct = %p, id=%ld, item=%p\n", current, item->id, item);
+
+    return SUCCESS;
+}
+
+
+/**
+ * @p p the process of the calling scheduler \n 
+ * @p ids the ums ids of the completion list \n 
+ * @p mem the memory in which the result is saved \n 
+ * @p len the length of the completion list \n 
+ * @p exist set to 1 if at least one of the workers in the list is still registered \n 
+ * 
+ * Copies @p ids in @p mem, leaving only the ids of the workers that are ready to be executed (the others are set to 0).
+ * Returns the number of ready workers.
+ */
+int ums_dequeue_scan(ums_process* p, unsigned long* ids, unsigned long* mem, unsigned long len, int* exist){
+    unsigned long i;
+    int found = 0;
+    struct thread_item* aux;
+
+    *exist = 0;
+    for(i=0; i<len; i++){
+        UMS_HASH_FIND_BY_ID(p, ids[i], aux);
+        if(!aux)                //the item does not exist yet, or it has exited alreay
+            mem[i] = 0;
+        else{
+            *exist = 1;
+            if(!UMS_TASK_IDLE(aux))
                 mem[i] = 0;
             else{
-                if(aux->task_struct->state != TASK_INTERRUPTIBLE){
-                    mem[i] = 0;
-                }
-                found = 1;
-                exist = 1;
+                mem[i] = ids[i];
+                found++;
             }
         }
     }
 
-    if(!found){
-        //printk(KERN_INFO MODULE_LOG "No thread found to be executed!");
+    return found;
+}
+
+/**
+ * @p p the process of the calling scheduler \n 
+ * @p ptr pointer to the memory in which the user saved the completion list \n 
+ * @p flags UMS_DEQUEUE_NONBLOCK to return immediately if no worker is ready \n 
+ * @p timeout maximum time to wait (in ms) for a worker to be ready, 0 to wait forever \n 
+ * 
+ * This function returns the ready threads that can be executed in the completion list
+ * of the calling scheduler thread. This is done by reading first the first 8 byte (sizeof(unsigned long))
+ * of the memory pointed by @p ptr (passed with IOCTL) to read the length of the list, then a new copy_from_user()
+ * is issued to read the list (now we know the dimension). This mechanism was used in order to avoid using 2
+ * different IOCTLs (one to read the length, and a second one to read the list). The same mechanism is used in function
+ * new_scheduler_management(). \n 
+ * If no worker is ready, the scheduler sleeps on its wait queue until a worker registers, yields or exits; it is
+ * woken up by ums_wake_schedulers(). If none of the workers in the list exists, the list is returned empty (all 0)
+ * so that the scheduler can finish. -EAGAIN is returned if no worker got ready before the timeout (or immediately,
+ * with UMS_DEQUEUE_NONBLOCK).
+ */
+int ums_dequeue_list(ums_process* p, unsigned long ptr, unsigned long flags, unsigned long timeout){
+    unsigned long len;
+    unsigned long *ids, *mem;
+    int ret;
+    sched_item* s;
+
+    if(!ptr){
+        printk(KERN_ALERT MODULE_LOG "NULL pointer found in ums_dequeue_list request!\n");
+        return UMS_ERROR;
+    }
+
+    UMS_FIND_SCHED_ITEM(p, current, s);
+    if(!s){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve the scheduler, aborting ums_dequeue_list\n");
+        return UMS_ERROR;
+    }
+
+    ret = ums_copy_list(ptr, &ids, &len);
+    if(ret){
+        printk(KERN_ALERT MODULE_LOG "Bad completion list, aborting ums_dequeue_list\n");
+        return ret;
     }
+    mem = ids + len;
 
-    copy_to_user((unsigned long*) (ptr + sizeof(unsigned long)), mem, len * sizeof(unsigned long));
+    //printk(KERN_INFO MODULE_LOG "number of items = %lu, 1st=%lu 2nd=%lu\n", len, ids[0], ids[1]);
 
-    kfree(mem);
+    timeout = timeout ? msecs_to_jiffies(timeout) : 0;
+    ret = ums_dequeue_wait(p, s, ids, mem, len, flags, &timeout);
+    if(ret < 0){
+        kfree(ids);
+        return ret;
+    }
+
+    if(copy_to_user((unsigned long*) (ptr + sizeof(unsigned long)), mem, len * sizeof(unsigned long)))
+        ret = -EFAULT;
+    else
+        ret = SUCCESS;
+
+    kfree(ids);
     
+    return ret;
+}
+
+/**
+ * @p ptr pointer to the memory in which the user saved the completion list \n 
+ * @p ids set to the buffer with the list \n 
+ * @p len set to the length of the list \n 
+ * 
+ * Reads a completion list from the user, with the layout described in ums_dequeue_list(). The buffer holds the ids
+ * followed by @p len more slots that the caller can use for the result; it has to be freed with kfree(). Returns
+ * -EINVAL if the list is empty or longer than UMS_MAX_LIST_LEN, -EFAULT if it can not be read, -ENOMEM if the
+ * buffer can not be allocated.
+ */
+int ums_copy_list(unsigned long ptr, unsigned long** ids, unsigned long* len){
+
+    *ids = 0;
+    if(copy_from_user(len, (unsigned long*) ptr, sizeof(*len)))
+        return -EFAULT;
+    if(!*len || *len > UMS_MAX_LIST_LEN)
+        return -EINVAL;
+
+    *ids = kmalloc_array(2 * *len, sizeof(unsigned long), GFP_KERNEL);
+    if(!*ids)
+        return -ENOMEM;
+
+    if(copy_from_user(*ids, (unsigned long*) (ptr + sizeof(unsigned long)), *len * sizeof(unsigned long))){
+        kfree(*ids);
+        *ids = 0;
+        return -EFAULT;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * @p p the process of the calling scheduler \n 
+ * @p s the calling scheduler \n 
+ * @p ids the ums ids of the completion list \n 
+ * @p mem the memory in which the result is saved (see ums_dequeue_scan()) \n 
+ * @p len the length of the completion list \n 
+ * @p flags UMS_DEQUEUE_NONBLOCK to return immediately if no worker is ready \n 
+ * @p timeout maximum time to wait (in jiffies) for a worker to be ready, 0 to wait forever; it is updated with the
+ * time left, so that a caller that waits again does not wait longer than the whole timeout \n 
+ * 
+ * Waits until at least one of the workers in @p ids is ready, and returns how many they are; 0 is returned if none
+ * of them exists, -EAGAIN if none got ready in time and -EINTR if the wait was interrupted by a signal.
+ */
+int ums_dequeue_wait(ums_process* p, sched_item* s, unsigned long* ids, unsigned long* mem, unsigned long len,
+                                                                        unsigned long flags, unsigned long* timeout){
+    int found, exist;
+    long ret = 1;
+
+    found = ums_dequeue_scan(p, ids, mem, len, &exist);
+
+    //if no thread is ready, sleep until one of them changes its state
+    if(!found && exist && !(flags & UMS_DEQUEUE_NONBLOCK)){
+        atomic_inc(&p->dequeue_waiters);
+        //pairs with the barrier in ums_wake_schedulers()
+        smp_mb__after_atomic();
+        if(*timeout){
+            ret = wait_event_interruptible_timeout(s->ready_wq,
+                        (found = ums_dequeue_scan(p, ids, mem, len, &exist)) || !exist, *timeout);
+            //when nothing got ready in time -EAGAIN is returned, thus 0 (i.e. forever) is never left here
+            if(ret > 0)
+                *timeout = ret;
+        }
+        else
+            ret = wait_event_interruptible(s->ready_wq,
+                        (found = ums_dequeue_scan(p, ids, mem, len, &exist)) || !exist);
+        atomic_dec(&p->dequeue_waiters);
+    }
+
+    if(ret < 0)
+        return -EINTR;
+    if(!found && exist)
+        return -EAGAIN;
+
+    return found;
+}
+
+/**
+ * @p p the process of the calling scheduler \n 
+ * @p ptr pointer to a ums_dequeue_args struct
+ * 
+ * Same as ums_dequeue_list(), but the flags and the timeout are given by the user together with the list.
+ */
+int ums_dequeue_list_ex(ums_process* p, unsigned long ptr){
+    ums_dequeue_args args;
+
+    if(!ptr || copy_from_user(&args, (ums_dequeue_args*) ptr, sizeof(args))){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in ums_dequeue_list_ex request!\n");
+        return UMS_ERROR;
+    }
+
+    return ums_dequeue_list(p, args.list, args.flags, args.timeout);
+}
+
+/**
+ * @p p the process of the calling scheduler \n 
+ * @p ptr pointer to a ums_dequeue_exec_args struct \n 
+ * 
+ * Performs ums_dequeue_list() and ums_schedule() in a single request: waits for a ready worker in the completion list,
+ * picks one of them according to the policy given by the user and executes it. UMS_POLICY_FIRST_READY picks the first
+ * ready worker of the list, UMS_POLICY_LOWEST_PRIO the ready worker with the lowest value in the array of priorities
+ * given with the list (the first one, in case of ties); any other policy is rejected with -EINVAL. If another
+ * scheduler executes the chosen worker first, the choice is done again. The id of the executed worker is saved in the
+ * executed field, 0 if none of the workers exists.
+ */
+int ums_dequeue_execute(ums_process* p, unsigned long ptr){
+    ums_dequeue_exec_args args;
+    unsigned long len, i, next;
+    unsigned long *ids, *mem;
+    int *prio = 0;
+    int ret;
+    sched_item* s;
+
+    if(!ptr || copy_from_user(&args, (ums_dequeue_exec_args*) ptr, sizeof(args)) || !args.list){
+        printk(KERN_ALERT MODULE_LOG "Bad pointer found in ums_dequeue_execute request!\n");
+        return UMS_ERROR;
+    }
+    if(args.policy != UMS_POLICY_FIRST_READY && args.policy != UMS_POLICY_LOWEST_PRIO){
+        printk(KERN_ALERT MODULE_LOG "Unknown policy %lu, aborting ums_dequeue_execute\n", args.policy);
+        return -EINVAL;
+    }
+    if(args.policy == UMS_POLICY_LOWEST_PRIO && !args.prio){
+        printk(KERN_ALERT MODULE_LOG "Priorities not given, aborting ums_dequeue_execute\n");
+        return UMS_ERROR;
+    }
+
+    UMS_FIND_SCHED_ITEM(p, current, s);
+    if(!s){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve the scheduler, aborting ums_dequeue_execute\n");
+        return UMS_ERROR;
+    }
+
+    ret = ums_copy_list(args.list, &ids, &len);
+    if(ret){
+        printk(KERN_ALERT MODULE_LOG "Bad completion list, aborting ums_dequeue_execute\n");
+        return ret;
+    }
+    mem = ids + len;
+
+    if(args.policy == UMS_POLICY_LOWEST_PRIO){
+        prio = kmalloc_array(len, sizeof(int), GFP_KERNEL);
+        if(!prio){
+            kfree(ids);
+            return -ENOMEM;
+        }
+        if(copy_from_user(prio, (int*) args.prio, len * sizeof(int))){
+            printk(KERN_ALERT MODULE_LOG "Bad priorities found, aborting ums_dequeue_execute\n");
+            kfree(prio);
+            kfree(ids);
+            return -EFAULT;
+        }
+    }
+
+    //every retry waits only for the time left of the timeout
+    args.timeout = args.timeout ? msecs_to_jiffies(args.timeout) : 0;
+    do{
+        ret = ums_dequeue_wait(p, s, ids, mem, len, args.flags, &args.timeout);
+        if(ret <= 0){
+            next = 0;
+            break;
+        }
+
+        next = len;
+        for(i=0; i<len; i++){
+            if(!mem[i])
+                continue;
+            if(next == len || (prio && prio[i] < prio[next]))
+                next = i;
+            if(!prio)
+                break;
+        }
+        next = ids[next];
+    }while(!ums_execute(p, next));
+
+    kfree(prio);
+    kfree(ids);
+
+    if(ret < 0)
+        return ret;
+
+    if(put_user(next, &((ums_dequeue_exec_args*) ptr)->executed))
+        return -EFAULT;
+
+    return SUCCESS;
+}
+
+/**
+ * @p p the process of the calling scheduler \n 
+ * @p ptr pointer to the number of switches \n 
+ * 
+ * Used by the schedulers that switch their workers in user space (futex mode of the library), that do not go through
+ * ums_schedule(): the switches they did are added to their counter, so that they are still shown in the /proc fs.
+ */
+int ums_account_switches(ums_process* p, unsigned long ptr){
+    unsigned long switches;
+    sched_item* s;
+
+    if(!ptr){
+        printk(KERN_ALERT MODULE_LOG "NULL pointer found in ums_account_switches request!\n");
+        return UMS_ERROR;
+    }
+
+    if(copy_from_user(&switches, (unsigned long*) ptr, sizeof(switches)))
+        return UMS_ERROR;
+
+    UMS_FIND_SCHED_ITEM(p, current, s);
+    if(!s){
+        printk(KERN_ALERT MODULE_LOG "Could not retrieve the scheduler, aborting ums_account_switches\n");
+        return UMS_ERROR;
+    }
+
+    UMS_STATS_WRITE_BEGIN(s);
+    s->stats.counter = s->stats.counter + switches;
+    UMS_STATS_WRITE_END(s);
+
     return SUCCESS;
 }
 
+/**
+ * @p t the scheduler, not (or no longer) in the list of its process
+ * 
+ * Frees the workers of @p t, its ready ring and the item itself; its /proc entries must have been removed already.
+ */
+void ums_free_sched_item(sched_item* t){
+    struct list_head* current_worker, *w;
+    worker_info * i;
+    int j;
+
+    for(j = 0; j < t->worker_num; j++)
+    {
+        i = t->workers[j];
+        //printk(KERN_INFO MODULE_LOG "Freeing worker, id = %d, ums_id=%ld\n", i->id, i->ums_id);
+        kmem_cache_free(worker_info_cache, i);
+    }
+    kfree(t->workers);
+    list_for_each_safe(current_worker, w, &t->free_workers)
+    {
+        i = list_entry(current_worker, worker_info, list);
+        list_del(current_worker);
+        kmem_cache_free(worker_info_cache, i);
+    }
+
+    //printk(KERN_INFO MODULE_LOG "Freeing scheduler, task_struct = %p, id=%ld\n", t->task_struct, t->id);
+    //if the ring is still mapped, the page is released when it is unmapped
+    free_page((unsigned long) t->ring);
+    kmem_cache_free(sched_item_cache, t);
+}
+
 void free_sched_list(ums_process* p){
 
     struct list_head* current_sched, *s;
-    struct list_head* current_worker, *w;
     sched_item * t;
-    worker_info * i;
-    unsigned long flags, flags1;
+    unsigned long flags;
 
     write_lock_irqsave(&p->sched_list_lock, flags);
 
@@ -522,21 +1731,8 @@ void free_sched_list(ums_process* p){
     list_for_each_safe(current_sched, s, &p->ums_sched_list)
     {
         t = list_entry(current_sched, sched_item, list);
-
-        //free every worker_info
-        write_lock_irqsave(&t->worker_list_lock, flags1);
-        list_for_each_safe(current_worker, w, &t->ums_worker_list)
-        {
-            i = list_entry(current_worker, worker_info, list);
-            list_del(current_worker);
-            //printk(KERN_INFO MODULE_LOG "Freeing worker, id = %d, ums_id=%ld\n", i->id, i->ums_id);
-            kfree(i);
-        }
-        write_unlock_irqrestore(&t->worker_list_lock, flags1);
-
         list_del(current_sched);
-        //printk(KERN_INFO MODULE_LOG "Freeing scheduler, task_struct = %p, id=%ld\n", t->task_struct, t->id);
-        kfree(t);
+        ums_free_sched_item(t);
     }
     write_unlock_irqrestore(&p->sched_list_lock, flags);
 }
@@ -544,22 +1740,23 @@ void free_sched_list(ums_process* p){
 void free_work_list(ums_process* p){
 
     thread_item *tmp;
-    struct list_head* current_item_list, *q;
-    struct task_struct* sched = 0;
+    struct hlist_node *q;
     unsigned long flags;
+    int bkt;
 
     write_lock_irqsave(&p->thread_list_lock, flags);
-    list_for_each_safe(current_item_list, q, &p->ums_thread_list)
+    hash_for_each_safe(p->thread_by_id, bkt, q, tmp, id_node)
     {
-        //printk(KERN_INFO MODULE_LOG "Iterating, current = %p, item=%p", current, tmp->task_struct);
-        tmp = list_entry(current_item_list, thread_item, list);
-        if(tmp->task_struct == current){
-            sched = tmp->scheduler;
-            //printk(KERN_INFO MODULE_LOG "Removing current_item=%p, current_item->id=%ld, calling sched: %p\n", tmp, tmp->id, sched);
-            list_del(current_item_list);
-            kfree(tmp);
-            break;
-        }
+        //printk(KERN_INFO MODULE_LOG "Removing current_item=%p, current_item->id=%ld\n", tmp, tmp->id);
+        hash_del(&tmp->id_node);
+        hash_del(&tmp->task_node);
+        kmem_cache_free(thread_item_cache, tmp);
+    }
+    //the items of parked threads are only in thread_by_task
+    hash_for_each_safe(p->thread_by_task, bkt, q, tmp, task_node)
+    {
+        hash_del(&tmp->task_node);
+        kmem_cache_free(thread_item_cache, tmp);
     }
     write_unlock_irqrestore(&p->thread_list_lock, flags);
 }
@@ -568,11 +1765,15 @@ void exit_ums_process_all(){
     ums_process* p;
     struct list_head* current_item_list, *q;
     unsigned long flags;
+    LIST_HEAD(processes);
 
+    //removing the /proc entries may sleep (it waits for their readers), so it is done out of the lock
     write_lock_irqsave(&processes_list_lock, flags);
+    list_splice_init(&ums_processes, &processes);
+    write_unlock_irqrestore(&processes_list_lock, flags);
 
     //free the ums_process 
-    list_for_each_safe(current_item_list, q, &ums_processes)
+    list_for_each_safe(current_item_list, q, &processes)
     {
         p = list_entry(current_item_list, ums_process, list);
             //delete /proc/pid/
@@ -583,60 +1784,53 @@ void exit_ums_process_all(){
 
             //remove from list
             list_del(current_item_list);
-            kfree(p);
+            kvfree(p);
     }
-
-    write_unlock_irqrestore(&processes_list_lock, flags);
 }
 
 /**
- * @p pid identifier of the process that is exiting UMS. We refer to "pid" in the user-space meaning of the term (i.e. tgid in kernel-space)
+ * @p p the process that is exiting UMS, as bound to its device file
  * 
  * This function clears the memory used by a user-space process when using UMS.
  */
-void exit_ums_process(int pid){
-    ums_process* p;
-    struct list_head* current_item_list, *q;
+void exit_ums_process(ums_process* p){
     unsigned long flags;
 
+    //the process is only unlinked under the lock: removing the /proc entries may sleep, and so may kvfree()
     write_lock_irqsave(&processes_list_lock, flags);
+    list_del(&p->list);
+    write_unlock_irqrestore(&processes_list_lock, flags);
 
-    //free the ums_process 
-    list_for_each_safe(current_item_list, q, &ums_processes)
-    {
-        p = list_entry(current_item_list, ums_process, list);
-        if(p->tgid == pid){
-            //delete /proc/pid/
-            ums_delete_proc_process(p);
-
-            free_sched_list(p);
-            free_work_list(p);
-
-            //remove from list
-            list_del(current_item_list);
-            kfree(p);
-        }
-    }
+    //delete /proc/pid/
+    ums_delete_proc_process(p);
 
-    write_unlock_irqrestore(&processes_list_lock, flags);
+    free_sched_list(p);
+    free_work_list(p);
 
+    kvfree(p);
 }
 
 /**
  * @p pid identifier of the process that is entring UMS. We refer to "pid" in the user-space meaning of the term (i.e. tgid in kernel-space)
  * 
- * This function initializes all the memory needed by a user space process to use UMS.
+ * This function initializes all the memory needed by a user space process to use UMS. The returned process
+ * is bound to the device file by device_ioctl(), so that the following requests do not need to look it up.
  */
-void init_ums_process(int pid){
-    ums_process* p = kmalloc(sizeof(ums_process), GFP_KERNEL);
+ums_process* init_ums_process(int pid){
+    ums_process* p = kvmalloc(sizeof(ums_process), GFP_KERNEL);
     unsigned long flags;
 
+    if(!p)
+        return 0;
+
     INIT_LIST_HEAD(&p->ums_sched_list);
-    INIT_LIST_HEAD(&p->ums_thread_list);
+    hash_init(p->thread_by_id);
+    hash_init(p->thread_by_task);
     p->thread_list_lock = __RW_LOCK_UNLOCKED(p->thread_list_lock);
     p->sched_list_lock = __RW_LOCK_UNLOCKED(p->sched_list_lock);
     p->counter_lock = __RW_LOCK_UNLOCKED(p->counter_lock);
-    p->choice_lock = __SPIN_LOCK_UNLOCKED(p->choice_lock);
+    atomic_set(&p->dequeue_waiters, 0);
+    p->switch_mode = UMS_SWITCH_WAKEUP;
     p->tgid = pid;
     p->num_sched = 0;
 
@@ -647,4 +1841,5 @@ void init_ums_process(int pid){
 
     ums_create_proc_process(p);
 
+    return p;
 }
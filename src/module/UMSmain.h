@@ -4,19 +4,24 @@
  * 
  * This header defines the core functions for the kernel implementation of this project. Once the module is loaded
  * a device file named /dev/ums-dev is created; this file is used to allow communication via IOCTL between
- * the kernel module and the library. 8 total requests are defined, they are listed as macros in this header.
+ * the kernel module and the library. The requests are listed as macros in this header.
  * The kernel module has been built and tested on linux kernel version 5.8.
  */
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/sched.h>
+#include <linux/sched/task.h>
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
 #include <linux/ktime.h>
 #include <linux/spinlock.h>
 #include <linux/timekeeping.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/log2.h>
 
 
 #include "UMSProcManager.h"
@@ -34,57 +39,188 @@
 #define UMS_THREAD_YIELD            6
 #define UMS_WORKER_DONE             7
 #define UMS_DEQUEUE                 8
+#define UMS_DEQUEUE_EX              9
+#define UMS_THREAD_YIELD_TO         10
+#define UMS_DEQUEUE_AND_EXECUTE     11
+#define UMS_ACCOUNT_SWITCHES        12
+#define UMS_LIST_ADD                13
+#define UMS_LIST_REMOVE             14
+#define UMS_ANNOUNCE_TASK           15
+#define UMS_WORKER_PARK             16
+#define UMS_WORKER_UNPARK           17
+#define UMS_SWITCH_MODE             18
+#define UMS_WORKER_PARKING          19
+
+//modes of UMS_SWITCH_MODE
+#define UMS_SWITCH_WAKEUP           0
+#define UMS_SWITCH_SAME_CPU         1
+
+//maximum length of a completion list given to the module, longer ones are rejected
+#define UMS_MAX_LIST_LEN            (1UL << 20)
+
+//flags of the slab caches; SLAB_NO_MERGE (kernel 6.5 and later) keeps them from being merged with other caches
+#ifdef SLAB_NO_MERGE
+#define UMS_CACHE_FLAGS             (SLAB_HWCACHE_ALIGN | SLAB_NO_MERGE)
+#else
+#define UMS_CACHE_FLAGS             SLAB_HWCACHE_ALIGN
+#endif
+
+//flags of UMS_DEQUEUE_EX
+#define UMS_DEQUEUE_NONBLOCK        1
+
+//policies of UMS_DEQUEUE_AND_EXECUTE
+#define UMS_POLICY_FIRST_READY      0
+#define UMS_POLICY_LOWEST_PRIO      1
 
 #define MODULE_LOG "UMSmain: "
 
+/**
+ * @p list pointer to the completion list, with the same layout used by UMS_DEQUEUE \n 
+ * @p flags UMS_DEQUEUE_NONBLOCK or 0 \n 
+ * @p timeout maximum time to wait for a ready worker (in ms), 0 to wait forever \n 
+ */
+typedef struct ums_dequeue_args{
+    unsigned long list;
+    unsigned long flags;
+    unsigned long timeout;
+}ums_dequeue_args;
+
+/**
+ * @p list pointer to the completion list, with the same layout used by UMS_DEQUEUE \n 
+ * @p prio pointer to the priorities of the workers in the list (one int each), needed by UMS_POLICY_LOWEST_PRIO \n 
+ * @p policy how the worker to be executed is chosen among the ready ones \n 
+ * @p flags UMS_DEQUEUE_NONBLOCK or 0 \n 
+ * @p timeout maximum time to wait for a ready worker (in ms), 0 to wait forever \n 
+ * @p executed set by the kernel to the id of the executed worker, 0 if none of the workers exists \n 
+ */
+typedef struct ums_dequeue_exec_args{
+    unsigned long list;
+    unsigned long prio;
+    unsigned long policy;
+    unsigned long flags;
+    unsigned long timeout;
+    unsigned long executed;
+}ums_dequeue_exec_args;
+
+/**
+ * @p list pointer to the completion list, with the same layout used by UMS_DEQUEUE \n 
+ * @p key the address of the completion list in the user space, it identifies the list in UMS_LIST_ADD/REMOVE \n 
+ */
+typedef struct ums_introduce_args{
+    unsigned long list;
+    unsigned long key;
+}ums_introduce_args;
+
+/**
+ * @p key the address of the completion list in the user space \n 
+ * @p ums_id the id of the thread added to (or removed from) the list \n 
+ */
+typedef struct ums_list_args{
+    unsigned long key;
+    unsigned long ums_id;
+}ums_list_args;
+
+/**
+ * @p tid the thread id (as given by gettid()) of the parked thread \n 
+ * @p ums_id the id of the worker that the thread will run from now on \n 
+ */
+typedef struct ums_unpark_args{
+    unsigned long tid;
+    unsigned long ums_id;
+}ums_unpark_args;
+
 
 
 
 
 //macros, to optimize:
-#define UMS_LIST_FIND_BY_ID(id, item, ums_thread_list)\
+/**
+ * True if the worker @p t is idle, i.e. it can be executed. A worker announced by its creator is not idle until it
+ * registers (see ums_announce_task()), nor is a parked one (see ums_worker_park()).
+ */
+#define UMS_TASK_IDLE(t)\
+    (atomic_read(&(t)->state) == UMS_THREAD_IDLE)
+
+/**
+ * Tries to take the idle worker @p t for execution; true if the caller got it, and then it has to wake it up. When
+ * more schedulers race for the same worker only one of them wins, the others are not serialized by any lock.
+ */
+#define UMS_TASK_CLAIM(t)\
+    (atomic_cmpxchg(&(t)->state, UMS_THREAD_IDLE, UMS_THREAD_BUSY) == UMS_THREAD_IDLE)
+
+/**
+ * Looks up a worker of the process @p p by its ums id; @p item is set to 0 if the worker is not registered.
+ */
+#define UMS_HASH_FIND_BY_ID(p, ums_id, item)\
 do{\
+    thread_item* current_item;\
+    unsigned long flags;\
     read_lock_irqsave(&p->thread_list_lock, flags);\
     item = 0;\
-    list_for_each(current_item_list, &ums_thread_list)\
+    hash_for_each_possible(p->thread_by_id, current_item, id_node, ums_id)\
     {\
-        current_item = list_entry(current_item_list, thread_item, list);\
-        if(current_item->id == id)\
+        if(current_item->id == ums_id){\
             item = current_item;\
+            break;\
+        }\
     }\
     read_unlock_irqrestore(&p->thread_list_lock, flags);\
 }while(0)
 
-
-#define UMS_LIST_FIND_SCHEDULER(sched, ums_thread_list)\
+/**
+ * Looks up a worker of the process @p p by its task_struct; @p item is set to 0 if the worker is not registered.
+ */
+#define UMS_HASH_FIND_BY_TASK(p, ts, item)\
 do{\
+    thread_item* current_item;\
+    unsigned long flags;\
     read_lock_irqsave(&p->thread_list_lock, flags);\
-    list_for_each(current_item_list, &ums_thread_list)\
+    item = 0;\
+    hash_for_each_possible(p->thread_by_task, current_item, task_node, (unsigned long) ts)\
     {\
-        current_item = list_entry(current_item_list, thread_item, list);\
-        if(current_item->task_struct == current)\
-            sched = current_item->scheduler;\
+        if(current_item->task_struct == ts){\
+            item = current_item;\
+            break;\
+        }\
     }\
     read_unlock_irqrestore(&p->thread_list_lock, flags);\
 }while(0)
 
 
-#define UMS_FIND_PROCESS_BY_TGID(pid, item)\
+/**
+ * These two macros delimit an update of the statistics of the scheduler @p s (see ums_sched_stats); the caller
+ * must be the task that currently owns the scheduler. A reset of the histograms requested through the /proc fs is
+ * done here.
+ */
+#define UMS_STATS_WRITE_BEGIN(s)\
 do{\
-    ums_process* current_item;\
-    struct list_head* current_item_list;\
-    unsigned long flags;\
-    read_lock_irqsave(&processes_list_lock, flags);\
-    item = 0;\
-    list_for_each(current_item_list, &ums_processes)\
-    {\
-        current_item = list_entry(current_item_list, ums_process, list);\
-        if(current_item->tgid == pid)\
-            item = current_item;\
+    preempt_disable();\
+    write_seqcount_begin(&(s)->stats.seq);\
+    if(unlikely(READ_ONCE((s)->hist_reset))){\
+        memset((s)->stats.to_worker, 0, sizeof((s)->stats.to_worker));\
+        memset((s)->stats.to_sched, 0, sizeof((s)->stats.to_sched));\
+        WRITE_ONCE((s)->hist_reset, 0);\
     }\
-    read_unlock_irqrestore(&processes_list_lock, flags);\
 }while(0)
 
+#define UMS_STATS_WRITE_END(s)\
+do{\
+    write_seqcount_end(&(s)->stats.seq);\
+    preempt_enable();\
+}while(0)
+
+/**
+ * Adds a switch that took @p ns nanoseconds to the histogram @p hist, must be used between UMS_STATS_WRITE_BEGIN
+ * and UMS_STATS_WRITE_END.
+ */
+#define UMS_HIST_ADD(hist, ns)\
+do{\
+    unsigned long __ns = (ns);\
+    int __bucket = __ns ? ilog2(__ns) : 0;\
+    if(__bucket >= UMS_HIST_BUCKETS)\
+        __bucket = UMS_HIST_BUCKETS - 1;\
+    hist[__bucket]++;\
+}while(0)
 
 #define UMS_FIND_SCHED_ITEM(p, ts, item)\
 do{\
@@ -106,15 +242,15 @@ do{\
 #define FIND_WORKER_BY_UMS_ID(s, id, item)\
 do{\
     worker_info* current_item;\
-    struct list_head* current_item_list;\
     unsigned long flags;\
     read_lock_irqsave(&s->worker_list_lock, flags);\
     item = 0;\
-    list_for_each(current_item_list, &s->ums_worker_list)\
+    hash_for_each_possible(s->worker_by_id, current_item, node, id)\
     {\
-        current_item = list_entry(current_item_list, worker_info, list);\
-        if(current_item->ums_id == id)\
+        if(current_item->ums_id == id){\
             item = current_item;\
+            break;\
+        }\
     }\
     read_unlock_irqrestore(&s->worker_list_lock, flags);\
 }while(0)
@@ -122,30 +258,59 @@ do{\
 //functions
 int __init ums_init(void);
 void __exit ums_exit(void);
+int ums_create_caches(void);
+void ums_destroy_caches(void);
 long device_ioctl(struct file *, unsigned int, unsigned long);
+int device_release(struct inode *, struct file *);
+int device_mmap(struct file *, struct vm_area_struct *);
 void put_task_to_sleep(void);
-int ums_schedule(unsigned long);
-int ums_thread_yield(void);
-int ums_thread_end(void);
+void put_task_to_sleep_notify(ums_process*, thread_item*);
+void ums_wake_schedulers(ums_process*);
+void ums_ring_publish(sched_item*, unsigned long);
+void ums_publish_ready(ums_process*, thread_item*);
+int ums_schedule(ums_process*, unsigned long);
+int ums_execute(ums_process*, unsigned long);
+int ums_thread_yield(ums_process*);
+int ums_thread_yield_to(ums_process*, unsigned long);
+int ums_update_switch_time(ums_process*, thread_item*);
+int ums_thread_end(ums_process*);
+void ums_worker_over(ums_process*, struct task_struct*);
+int ums_set_switch_mode(ums_process*, unsigned long);
+void ums_switch_to(ums_process*, thread_item*);
+void ums_move_to_current_cpu(thread_item*);
+int ums_worker_movable(thread_item*);
+void ums_restore_cpus(thread_item*);
+int ums_worker_parking(ums_process*);
+int ums_worker_park(ums_process*);
+int ums_worker_unpark(ums_process*, unsigned long);
 
 int ums_create_worker_list(sched_item*, unsigned long);
+int ums_reserve_worker_slot(sched_item*);
+int ums_add_worker(sched_item*, unsigned long);
+int ums_remove_worker(sched_item*, unsigned long);
+void ums_free_sched_item(sched_item*);
 void free_sched_list(ums_process*);
 void free_work_list(ums_process*);
 
 //ioctl management
-void exit_ums_process(int);
-void init_ums_process(int);
-int new_task_management(unsigned long);
-int new_scheduler_management(unsigned long);
-int ums_dequeue_list(unsigned long);
+void exit_ums_process(ums_process*);
+ums_process* init_ums_process(int);
+int new_task_management(ums_process*, unsigned long);
+int ums_announce_task(ums_process*, unsigned long);
+int new_scheduler_management(ums_process*, unsigned long);
+int ums_dequeue_list(ums_process*, unsigned long, unsigned long, unsigned long);
+int ums_dequeue_list_ex(ums_process*, unsigned long);
+int ums_dequeue_scan(ums_process*, unsigned long*, unsigned long*, unsigned long, int*);
+int ums_dequeue_wait(ums_process*, sched_item*, unsigned long*, unsigned long*, unsigned long, unsigned long, unsigned long*);
+int ums_copy_list(unsigned long, unsigned long**, unsigned long*);
+int ums_dequeue_execute(ums_process*, unsigned long);
+int ums_account_switches(ums_process*, unsigned long);
+int ums_list_change(ums_process*, unsigned long, int);
 void exit_ums_process_all(void);
 
-//list operations
-void ums_print_list(void);
-thread_item* ums_list_find_by_id(unsigned long);
-struct task_struct* ums_list_find_scheduler(void);
 
 //aux
 sched_item* ums_find_sched(ums_process*, struct task_struct*);
+thread_item* ums_get_thread_item(ums_process*, unsigned long);
 worker_info* find_worker_by_ums_id(sched_item*, unsigned long);
 
@@ -5,26 +5,101 @@
  * This header defines the core definitions used by all the files of the project.
  */
 #include <linux/init.h>
+#include <linux/hashtable.h>
+#include <linux/wait.h>
+#include <linux/seqlock.h>
+#include <linux/types.h>
+#include <linux/cache.h>
+
+//number of bits of the per-process thread hash tables (2^bits buckets each)
+#define UMS_THREAD_HASH_BITS    12
+
+//number of bits of the per-scheduler worker hash table
+#define UMS_WORKER_HASH_BITS    6
+
+//initial number of slots of the worker array of a scheduler, it is doubled when it is full
+#define UMS_WORKER_MIN_SLOTS    16
+
+//state of a thread_item: UMS_THREAD_IDLE while it waits to be executed, UMS_THREAD_BUSY otherwise (running,
+//not registered yet, or parked)
+#define UMS_THREAD_BUSY         0
+#define UMS_THREAD_IDLE         1
+
+//pool state of a thread_item (see ums_worker_park()); only a parking or parked thread can be unparked
+#define UMS_POOL_NONE           0
+#define UMS_POOL_PARKING        1
+#define UMS_POOL_PARKED         2
+#define UMS_POOL_UNPARKED       3
+
+//number of buckets of the switch latency histograms, bucket i counts the switches that took [2^i, 2^(i+1)) ns
+#define UMS_HIST_BUCKETS        32
 
 
 /**
  * @p id the id of the thread \n 
- * @p task_struct pointer to the thread's task struct \n 
+ * @p task_struct pointer to the thread's task struct, NULL until the thread registers (see ums_announce_task()) \n 
  * @p scheduler pointer to the (last) scheduler of the thread \n 
+ * @p id_node node in the process' hash table indexed by @p id \n 
+ * @p task_node node in the process' hash table indexed by @p task_struct, unhashed until the thread registers \n 
+ * @p pool_state UMS_POOL_NONE, or where a pooled thread is between two workers: UMS_POOL_PARKING once it is in the
+ * pool of the library, UMS_POOL_PARKED while it sleeps in ums_worker_park() and UMS_POOL_UNPARKED once it was given a
+ * new id \n 
+ * @p moved_cpu the CPU the thread was constrained to by UMS_SWITCH_SAME_CPU, -1 if its CPUs were not changed (see
+ * ums_move_to_current_cpu()); only the scheduler that claimed the thread touches it \n 
+ * @p state UMS_THREAD_IDLE or UMS_THREAD_BUSY; a scheduler executes the thread only if it is the one that moves it
+ * from idle to busy (see UMS_TASK_CLAIM), thus two schedulers never run the same thread \n 
  */
 typedef struct thread_item
 {
         unsigned long id;
         struct task_struct* task_struct;
         struct task_struct* scheduler;
-        struct list_head list;
+        short pool_state;
+        short moved_cpu;
+        atomic_t state;
+        struct hlist_node id_node;
+        struct hlist_node task_node;
 } thread_item;
 
+//number of slots of the ready ring of a scheduler, it must be a power of 2
+#define UMS_RING_SIZE           256
+
+/**
+ * @p head index of the next slot that will be written by the kernel \n 
+ * @p tail index of the next slot that will be read by the library \n 
+ * @p overflow set by the kernel when an id was dropped because the ring was full \n 
+ * @p ids the ums ids of the ready workers \n 
+ * 
+ * Ring shared with the library (mapped through the device file) in which the kernel publishes the workers
+ * of a scheduler that are ready to be executed. The kernel is the only producer, the scheduler the only consumer;
+ * the same layout is defined in UMSLibrary.h. Head and tail live in different cache lines.
+ */
+typedef struct ums_ready_ring
+{
+        unsigned long head;
+        unsigned long pad0[7];
+        unsigned long tail;
+        unsigned long pad1[7];
+        unsigned long overflow;
+        unsigned long pad2[7];
+        unsigned long ids[UMS_RING_SIZE];
+} ums_ready_ring;
+
 /**
  * @p id the id of the thread (from 0 to n) \n 
  * @p ums_id the id of the thread (as given by the threads' implementation) \n 
  * @p state the state of the thread, 1 is running and 0 is idle \n 
  * @p counter the counter of the times this thread had been switched in \n 
+ * @p sched the scheduler whose completion list contains the thread \n 
+ * @p entry the /proc entry of the thread \n 
+ * @p slot the position of the thread in the worker array of the scheduler \n 
+ * @p node node in the worker hash table of the scheduler, indexed by @p ums_id \n 
+ * @p list node in the free_workers list of the scheduler, once the thread was removed \n 
+ * 
+ * state and counter are statistics of the scheduler, they are protected by its seqcount (see ums_sched_stats).
+ * Once a thread is removed from the completion list its worker_info is not freed, but kept in the free_workers list
+ * of the scheduler and reused by the next thread added to the list: the switch paths look it up without holding
+ * any lock while they update the statistics, thus it can not be freed while the scheduler is alive.
  */
 typedef struct worker_info
 {
@@ -32,65 +107,182 @@ typedef struct worker_info
         unsigned long ums_id;
         int state;
         int counter;
+        struct sched_item* sched;
+        struct proc_dir_entry* entry;
+        int slot;
+        struct hlist_node node;
         struct list_head list;
 }worker_info;
 
 /**
- * @p ums_id the id of the scheduler (as given by the threads' implementation) \n 
- * @p worker_num the number of the workers in the completion list \n 
- * @p task_struct pointer to the thread's task struct \n 
- * @p dir pointer to the scheduler/id directory \n 
- * @p workers pointer to the scheduler/id/workers/ directory \n 
- * @p info pointer to the scheduler/id/info file \n 
+ * @p seq seqcount protecting the block, and the state and counter of the scheduler's workers \n 
  * @p counter total number of switches \n 
  * @p total_time the sum of the time needed to do the switches (used to compute the avg) \n 
  * @p time the time needed for the last switch \n 
  * @p last_time auxiliary field used to compute "time" \n 
  * @p state the state of the scheduler, 1 is running and 0 is idle \n 
  * @p running the id of the worker which is currently running, -1 if none of them is running \n 
- * @p ums_worker_list list of workers \n 
+ * @p yield_time when the running worker gave the control back to the scheduler, 0 if it did not \n 
+ * @p to_worker histogram of the switches from the scheduler to a worker (see UMS_HIST_BUCKETS) \n 
+ * @p to_sched histogram of the switches from a worker back to the scheduler \n 
+ * @p steals number of switches to workers that are not in the completion list of the scheduler, i.e. stolen from
+ * another scheduler \n 
+ * 
+ * Statistics of a scheduler. The block is only written by the task that owns the scheduler at that moment: the
+ * scheduler itself until it wakes up a worker, then that worker until it gives the control back; thus the writers
+ * never run concurrently and they do not need any lock, they only disable preemption so that a reader can not spin
+ * on a preempted writer. Readers (the /proc fs) take a consistent snapshot with ums_sched_stats_read().
+ */
+typedef struct ums_sched_stats
+{
+        seqcount_t seq;
+        unsigned long counter;
+        unsigned long total_time;
+        unsigned long time;
+        unsigned long last_time;
+        int state;
+        unsigned long running;
+        unsigned long yield_time;
+        unsigned long to_worker[UMS_HIST_BUCKETS];
+        unsigned long to_sched[UMS_HIST_BUCKETS];
+        unsigned long steals;
+}ums_sched_stats;
+
+/**
+ * @p ums_id the id of the scheduler (as given by the threads' implementation) \n 
+ * @p worker_num the number of the workers in the completion list \n 
+ * @p next_worker_id the id that will be given to the next worker added to the list \n 
+ * @p list_key the address of the completion list in the user space, used to find the schedulers of a list \n 
+ * @p node the NUMA node on which the scheduler was introduced, its data (and its workers' data) is allocated there \n 
+ * @p task_struct pointer to the thread's task struct \n 
+ * @p dir pointer to the scheduler/id directory \n 
+ * @p workers_dir pointer to the scheduler/id/workers/ directory \n 
+ * @p info pointer to the scheduler/id/info file \n 
+ * @p stats the statistics of the scheduler \n 
+ * @p hist_reset set by a write on the scheduler/id/histogram file, the histograms are cleared by the next writer of
+ * @p stats (the /proc fs can not write them, since the writers do not take any lock) \n 
+ * @p workers dense array of the workers, @p worker_num of them (the order changes when a worker is removed) \n 
+ * @p workers_cap number of slots of @p workers \n 
+ * @p worker_by_id hash table of the workers, indexed by their ums_id, used by the switch paths \n 
+ * @p free_workers worker_info removed from @p workers, to be reused (see worker_info) \n 
+ * @p ready_wq wait queue on which the scheduler sleeps while none of its workers is ready \n 
+ * @p ring the ready ring of the scheduler (one page) \n 
+ * @p ring_lock serializes the workers that publish in the ring \n 
+ * @p ring_mapped set once the scheduler mapped the ring, nothing is published before \n 
+ * 
+ * @p stats is written by the scheduler at every switch and @p ready_wq, @p ring and @p ring_lock by its workers, thus
+ * both blocks start on their own cacheline (the items are allocated from a cacheline aligned slab cache).
  */
 typedef struct sched_item
 {
         //info
         unsigned long id;
         int worker_num;
+        int next_worker_id;
+        unsigned long list_key;
+        int node;
         struct task_struct* task_struct;
         //proc fs
         struct proc_dir_entry *dir;
-        struct proc_dir_entry *workers;
+        struct proc_dir_entry *workers_dir;
         struct proc_dir_entry *info;
         //data for sched/info
-        unsigned long counter;
-        unsigned long total_time;
-        unsigned long time;
-        unsigned long last_time;
-        int state;
-        unsigned long running;
+        ums_sched_stats stats ____cacheline_aligned_in_smp;
+        int hist_reset;
         //workers
-        struct list_head ums_worker_list;
+        worker_info** workers;
+        int workers_cap;
+        DECLARE_HASHTABLE(worker_by_id, UMS_WORKER_HASH_BITS);
+        struct list_head free_workers;
         rwlock_t worker_list_lock;
+        wait_queue_head_t ready_wq ____cacheline_aligned_in_smp;
+        ums_ready_ring* ring;
+        spinlock_t ring_lock;
+        int ring_mapped;
         struct list_head list;
 } sched_item;
 
+//layout of /proc/ums/<pid>/stats, mirrored in UMSLibrary.h and UMSHeader.h: keep them in sync
+#define UMS_STATS_MAGIC         0x53534d55      //"UMSS"
+#define UMS_STATS_VERSION       2
+
+/**
+ * @p magic UMS_STATS_MAGIC \n 
+ * @p version UMS_STATS_VERSION, incremented at every change of the layout \n 
+ * @p num_sched the number of ums_stats_sched records that follow \n 
+ * @p num_workers the total number of ums_stats_worker records \n 
+ * 
+ * Header of /proc/ums/<pid>/stats. The file is made of this header and, for every scheduler, a ums_stats_sched
+ * record followed by the ums_stats_worker records of its workers (worker_num of them). All the fields have a fixed
+ * size and the records are multiple of 8 bytes, so that the file can be read with a single read and cast.
+ */
+typedef struct ums_stats_header
+{
+        __u32 magic;
+        __u32 version;
+        __u32 num_sched;
+        __u32 num_workers;
+}ums_stats_header;
+
+/**
+ * @p id the id of the scheduler \n 
+ * @p switches total number of switches \n 
+ * @p total_time the sum of the time needed to do the switches, in ns \n 
+ * @p last_time the time needed for the last switch, in ns \n 
+ * @p running the id of the worker which is currently running, -1 if none of them is running \n 
+ * @p steals the number of switches to workers stolen from another scheduler \n 
+ * @p state the state of the scheduler, 1 is running and 0 is idle \n 
+ * @p worker_num the number of ums_stats_worker records that follow \n 
+ */
+typedef struct ums_stats_sched
+{
+        __u64 id;
+        __u64 switches;
+        __u64 total_time;
+        __u64 last_time;
+        __s64 running;
+        __u64 steals;
+        __u32 state;
+        __u32 worker_num;
+}ums_stats_sched;
+
+/**
+ * @p ums_id the id of the thread (as given by the threads' implementation) \n 
+ * @p switches the number of times this thread had been switched in by the scheduler \n 
+ * @p id the id of the thread in the completion list of the scheduler \n 
+ * @p state the state of the thread, 1 is running and 0 is idle \n 
+ */
+typedef struct ums_stats_worker
+{
+        __u64 ums_id;
+        __u64 switches;
+        __u32 id;
+        __u32 state;
+}ums_stats_worker;
+
 /**
  * @p tgid the tgid of the process \n 
  * @p num_sched number schedulers this process is managing \n 
- * @p ums_thread_list list of the workers of this process \n 
+ * @p thread_by_id hash table of the workers of this process, indexed by ums id \n 
+ * @p thread_by_task hash table of the workers of this process, indexed by task_struct \n 
  * @p ums_sched_list list of the schedulers of this process \n 
  * @p proc_dir pointer to the /proc/pid directory \n 
  * @p sched_dir pointer to the proc/pid/sched/ directory \n 
+ * @p dequeue_waiters number of schedulers sleeping in ums_dequeue_list() \n 
+ * @p switch_mode how the schedulers give the CPU to the workers, see ums_switch_to() \n 
  */
 typedef struct ums_process
 {
     int tgid;
     int num_sched;
     rwlock_t counter_lock;
-    struct list_head ums_thread_list;
+    DECLARE_HASHTABLE(thread_by_id, UMS_THREAD_HASH_BITS);
+    DECLARE_HASHTABLE(thread_by_task, UMS_THREAD_HASH_BITS);
     rwlock_t sched_list_lock;
     struct list_head ums_sched_list;
     rwlock_t thread_list_lock;
-    spinlock_t choice_lock;
+    atomic_t dequeue_waiters;
+    int switch_mode;
     unsigned long flags;
     struct proc_dir_entry *proc_dir;
     struct proc_dir_entry *sched_dir;